@@ -0,0 +1,742 @@
+/* rs-csv-parallel.c --- parallel reader for comma-separated values files
+
+   Copyright (C) 2010 Ralph Schleicher
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+      * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+
+      * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in
+        the documentation and/or other materials provided with the
+        distribution.
+
+      * Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived
+        from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.  */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "rs-csv-parallel.h"
+
+/* Set ‘errno’ and return VALUE back to the caller.  */
+#define set_errno_and_return_value(e,value)				\
+do									\
+  {									\
+    errno = (e);							\
+    return value;							\
+  }									\
+while (0)
+
+/* Default number of characters of a chunk.  */
+#define CHUNK_SIZE (1024 * 1024)
+
+/* Default number of chunks in progress.  */
+#define WINDOW 64
+
+/* Quote parity of a block of the memory buffer, see ‘scan_blocks’.  */
+typedef struct block block_t;
+
+struct block
+  {
+    /* First line start in the block after an even and after an odd
+       number of quote characters.  A null pointer means that there
+       is no such line start.  */
+    char const *even;
+    char const *odd;
+
+    /* Number of quote characters in the block modulo two.  */
+    int parity;
+  };
+
+/* Arguments for ‘scan_blocks’.  */
+typedef struct scan scan_t;
+
+struct scan
+  {
+    /* The memory buffer.  */
+    char const *buf;
+    char const *end;
+
+    /* Number of characters of a block.  */
+    size_t size;
+
+    /* The quote character converted to an unsigned char or ‘EOF’
+       if the quote parity is not determined.  Then every line start
+       counts as a line start after an even number of quotes.  */
+    int quote;
+
+    /* Array of blocks.  */
+    block_t *block;
+  };
+
+/* A parsed row.  */
+typedef struct row row_t;
+
+struct row
+  {
+    /* Offset of the row buffer in the text of the chunk.  */
+    size_t text;
+
+    /* Index of the first field and number of fields.  */
+    size_t field;
+    size_t count;
+
+    /* Line number after the row relative to the chunk (one based).  */
+    int line;
+  };
+
+/* A chunk of the memory buffer.  */
+typedef struct chunk chunk_t;
+
+struct chunk
+  {
+    /* Characters of the chunk.  */
+    char const *start;
+    char const *end;
+
+    /* CSV object providing the settings.  */
+    rs_csv_t const *proto;
+
+    /* CSV object used for parsing the chunk.  */
+    rs_csv_t *csv;
+
+    /* End of the last complete row and the line number at that
+       position relative to the chunk (one based).  Parsing continues
+       from there if the chunk is extended.  */
+    char const *good;
+    int good_line;
+
+    /* Status of the last call of ‘rs_csv_parse_row’ with ‘EOF’ mapped
+       to zero, the value of ‘errno’ in case of a system error, the
+       line number at the end of the chunk (one based), and the number
+       of characters not parsed.  */
+    int status;
+    int err;
+    int line;
+    size_t rest;
+
+    /* Parsed rows.  The row buffers are stored one after another in
+       TEXT.  */
+    size_t row_count;
+    size_t row_size;
+    row_t *row;
+
+    size_t field_count;
+    size_t field_size;
+    rs_csv_field_t *field;
+
+    size_t text_len;
+    size_t text_size;
+    char *text;
+
+    /* Non-zero means that the chunk is part of its predecessor.  */
+    int merged;
+
+    /* Row index and line number before the first row of the chunk.  */
+    int row_base;
+    int line_base;
+
+    /* Call-back function for delivering rows and its return value.  */
+    int (*fun) (int, int, char const *, rs_csv_field_t const *, size_t, void *);
+    void *arg;
+    int ret;
+
+    /* Pending work order.  Non-zero DELIVERY means that the work
+       order delivers the rows, otherwise it parses the chunk.  */
+    rs_workshop_future_t *future;
+    int delivery;
+  };
+
+/* Initialize the options for parsing in parallel.  */
+void
+rs_csv_parallel_options_init (rs_csv_parallel_options_t *options)
+{
+  options->chunk_size = 0;
+  options->window = 0;
+  options->unordered = 0;
+}
+
+/* Make room for NEED elements of SIZE bytes in the array ADDR with
+   *CAPACITY elements.  Return value is the address of the array.
+   In case of an error, a null pointer is returned and the array is
+   left unchanged.  */
+static void *
+grow (void *addr, size_t *capacity, size_t need, size_t size)
+{
+  size_t n;
+
+  if (need <= *capacity)
+    return addr;
+
+  n = (*capacity > 0 ? *capacity : 64);
+  while (n < need)
+    {
+      if (n > (size_t) -1 / 2 / size)
+	set_errno_and_return_value (ENOMEM, NULL);
+
+      n *= 2;
+    }
+
+  addr = realloc (addr, n * size);
+  if (addr != NULL)
+    *capacity = n;
+
+  return addr;
+}
+
+/* Determine the quote parity of the blocks BEGIN up to but excluding
+   END.  Argument ARG is the scan object.
+
+   A position is a line start if the preceding character is a line
+   feed or a carriage return not followed by a line feed.  If the
+   number of quote characters from the beginning of the buffer up to
+   a line start is even, the line start is the beginning of a row,
+   unless quote characters occur outside of quoted field values.  */
+static void
+scan_blocks (size_t begin, size_t end, void *arg)
+{
+  scan_t *s = arg;
+  block_t *b;
+  char const *p, *e;
+  size_t k;
+
+  for (k = begin; k < end; ++k)
+    {
+      b = s->block + k;
+      b->even = NULL;
+      b->odd = NULL;
+      b->parity = 0;
+
+      p = s->buf + k * s->size;
+      e = (s->size < (size_t) (s->end - p) ? p + s->size : s->end);
+
+      /* Find the first line starts.  */
+      for (; p < e && (b->even == NULL
+		       || (b->odd == NULL && s->quote != EOF)); ++p)
+	{
+	  if (p > s->buf && (p[-1] == '\n' || (p[-1] == '\r' && p[0] != '\n')))
+	    {
+	      if (b->parity == 0)
+		{
+		  if (b->even == NULL)
+		    b->even = p;
+		}
+	      else
+		{
+		  if (b->odd == NULL)
+		    b->odd = p;
+		}
+	    }
+
+	  if (s->quote != EOF && (unsigned char) *p == s->quote)
+	    b->parity ^= 1;
+	}
+
+      /* Count the remaining quote characters.  */
+      if (s->quote != EOF)
+	{
+	  while (p < e && (p = memchr (p, s->quote, e - p)) != NULL)
+	    {
+	      b->parity ^= 1;
+	      ++p;
+	    }
+	}
+    }
+}
+
+/* Prepare a chunk for parsing the characters from START up to but
+   excluding END.  */
+static void
+begin_chunk (chunk_t *c, char const *start, char const *end, rs_csv_t const *proto)
+{
+  c->start = start;
+  c->end = end;
+  c->proto = proto;
+
+  if (c->csv != NULL)
+    rs_csv_delete (c->csv);
+
+  c->csv = NULL;
+  c->good = start;
+  c->good_line = 1;
+  c->row_count = 0;
+  c->field_count = 0;
+  c->text_len = 0;
+  c->merged = 0;
+  c->ret = 0;
+}
+
+/* Parse the rows of a chunk.  Argument ARG is the chunk.
+
+   Parsing starts after the last complete row.  Thus, the rows
+   of a chunk which has been extended are not parsed again.  */
+static void *
+parse_chunk (void *arg)
+{
+  chunk_t *c = arg;
+  rs_csv_field_t const *field;
+  char const *buf;
+  size_t count, len;
+  rs_csv_t *csv;
+  int lines;
+  row_t *r;
+  void *p;
+
+  c->err = 0;
+
+  /* Keep the settings of a previous parser, e.g. a fixed delimiter
+     character.  */
+  csv = rs_csv_clone (c->csv != NULL ? c->csv : c->proto);
+  if (csv == NULL)
+    goto system_error;
+
+  if (c->csv != NULL)
+    rs_csv_delete (c->csv);
+
+  c->csv = csv;
+
+  rs_csv_set_buffer (c->csv, c->good, c->end - c->good);
+
+  /* Line numbers of the parser are relative to the last complete
+     row.  */
+  lines = c->good_line - 1;
+
+  while (1)
+    {
+      c->status = rs_csv_parse_row (c->csv, NULL, &field, &count);
+      if (c->status != 0)
+	break;
+
+      buf = rs_csv_row_buffer (c->csv);
+      len = field[count - 1].off + field[count - 1].len + 1;
+
+      p = grow (c->row, &c->row_size, c->row_count + 1, sizeof (row_t));
+      if (p == NULL)
+	goto system_error;
+
+      c->row = p;
+
+      p = grow (c->field, &c->field_size, c->field_count + count, sizeof (rs_csv_field_t));
+      if (p == NULL)
+	goto system_error;
+
+      c->field = p;
+
+      p = grow (c->text, &c->text_size, c->text_len + len, 1);
+      if (p == NULL)
+	goto system_error;
+
+      c->text = p;
+
+      r = c->row + c->row_count;
+      r->text = c->text_len;
+      r->field = c->field_count;
+      r->count = count;
+      r->line = lines + rs_csv_line (c->csv);
+
+      memcpy (c->text + c->text_len, buf, len);
+      memcpy (c->field + c->field_count, field, count * sizeof (rs_csv_field_t));
+
+      c->row_count += 1;
+      c->field_count += count;
+      c->text_len += len;
+
+      c->good = rs_csv_buffer (c->csv, &len);
+      c->good_line = r->line;
+    }
+
+  if (c->status == RS_CSV_SYSTEM_ERROR)
+    c->err = errno;
+  else if (c->status == RS_CSV_END_OF_FILE)
+    c->status = 0;
+
+  c->line = lines + rs_csv_line (c->csv);
+  rs_csv_buffer (c->csv, &c->rest);
+
+  return NULL;
+
+ system_error:
+
+  c->status = RS_CSV_SYSTEM_ERROR;
+  c->err = errno;
+  c->line = c->good_line;
+  c->rest = c->end - c->good;
+
+  return NULL;
+}
+
+/* Deliver the rows of a chunk.  Argument ARG is the chunk.  */
+static void *
+deliver_chunk (void *arg)
+{
+  chunk_t *c = arg;
+  row_t const *r;
+  size_t k;
+
+  c->ret = 0;
+
+  for (k = 0; k < c->row_count; ++k)
+    {
+      r = c->row + k;
+
+      c->ret = c->fun (c->row_base + (int) k, c->line_base + r->line - 1,
+		       c->text + r->text, c->field + r->field, r->count,
+		       c->arg);
+      if (c->ret != 0)
+	break;
+    }
+
+  return NULL;
+}
+
+/* Place a work order for a chunk.  If the workshop rejects the work
+   order, call FUN directly.  */
+static void
+order (rs_workshop_t *workshop, chunk_t *c, void *(*fun) (void *), int delivery)
+{
+  c->delivery = delivery;
+
+  c->future = rs_workshop_order_future (workshop, fun, c);
+  if (c->future == NULL)
+    fun (c);
+}
+
+/* Wait for the pending work order of a chunk.  If STOP is non-zero,
+   cancel the work order if it is still queued.  */
+static void
+finish (chunk_t *c, int stop)
+{
+  if (c->future == NULL)
+    return;
+
+  if (stop != 0)
+    rs_workshop_future_cancel (c->future);
+
+  rs_workshop_future_release (c->future);
+  c->future = NULL;
+}
+
+/* Parse the memory buffer of a CSV object in parallel.  */
+int
+rs_csv_parse_parallel (rs_csv_t *obj, rs_workshop_t *workshop, rs_csv_parallel_options_t const *options, int (*fun) (int, int, char const *, rs_csv_field_t const *, size_t, void *), void *arg, int *line)
+{
+  rs_csv_parallel_options_t defaults;
+  size_t chunk_size, window, len, size, blocks, bounds, next, k, j, m;
+  char const *buf, *end, *p, **bound;
+  char const *quote;
+  block_t *block;
+  scan_t scan;
+  rs_csv_t *base, *proto;
+  chunk_t *chunk, *c, *n;
+  int row_base, line_base, parity, status, result, err;
+
+  if (obj == NULL || workshop == NULL || fun == NULL)
+    {
+      errno = EINVAL;
+      return RS_CSV_SYSTEM_ERROR;
+    }
+
+  if (options == NULL)
+    {
+      rs_csv_parallel_options_init (&defaults);
+      options = &defaults;
+    }
+
+  chunk_size = (options->chunk_size > 0 ? options->chunk_size : CHUNK_SIZE);
+  window = (options->window > 0 ? options->window : WINDOW);
+
+  /* The memory buffer.  */
+  buf = rs_csv_buffer (obj, &len);
+  if (buf == NULL)
+    {
+      errno = EINVAL;
+      return RS_CSV_SYSTEM_ERROR;
+    }
+
+  end = buf + len;
+
+  /* Continue from the state of OBJ.  */
+  row_base = rs_csv_row (obj) + 1;
+  line_base = rs_csv_line (obj);
+
+  /* Nothing left to parse.  */
+  if (len == 0 || rs_csv_status (obj) == RS_CSV_END_OF_FILE)
+    {
+      if (line != NULL)
+	*line = line_base;
+
+      return 0;
+    }
+
+  if (rs_csv_column (obj) >= 0 && ! rs_csv_endp (obj))
+    {
+      errno = EINVAL;
+      return RS_CSV_SYSTEM_ERROR;
+    }
+
+  /* Split the memory buffer into blocks of CHUNK_SIZE characters and
+     determine the quote parity of the blocks in parallel.  Quote
+     parity only works with a single quote character.  Otherwise,
+     every line start is assumed to be the beginning of a row.  */
+  blocks = (len - 1) / chunk_size + 1;
+
+  block = malloc (blocks * sizeof (block_t));
+  bound = malloc ((blocks + 1) * sizeof (char const *));
+  chunk = calloc (window, sizeof (chunk_t));
+  base = rs_csv_clone (obj);
+  proto = NULL;
+
+  if (block == NULL || bound == NULL || chunk == NULL || base == NULL)
+    {
+      err = errno;
+
+      free (block);
+      free (bound);
+      free (chunk);
+
+      if (base != NULL)
+	rs_csv_delete (base);
+
+      errno = err;
+      return RS_CSV_SYSTEM_ERROR;
+    }
+
+  quote = rs_csv_quote_start (obj, &size);
+
+  scan.buf = buf;
+  scan.end = end;
+  scan.size = chunk_size;
+  scan.quote = (size == 1 ? (unsigned char) quote[0] : EOF);
+  scan.block = block;
+
+  if (rs_workshop_for (workshop, 0, blocks, 1, scan_blocks, &scan) != 0)
+    scan_blocks (0, blocks, &scan);
+
+  /* Combine the parities of the blocks.  A chunk starts at the first
+     line start of a block outside of a quoted field value.  */
+  bound[0] = buf;
+  bounds = 1;
+
+  parity = block[0].parity;
+  for (k = 1; k < blocks; ++k)
+    {
+      p = (parity == 0 ? block[k].even : block[k].odd);
+      if (p != NULL)
+	bound[bounds++] = p;
+
+      parity ^= block[k].parity;
+    }
+
+  bound[bounds] = end;
+
+  status = 0;
+  result = 0;
+  err = 0;
+
+  /* Parse the first chunk before the others so that a delimiter
+     character fixed by the first chunk applies to all chunks.  If
+     the delimiter character is not yet known, the first chunk is
+     extended below before other chunks are placed.  */
+  c = chunk;
+  begin_chunk (c, bound[0], bound[1], base);
+  next = 1;
+
+  parse_chunk (c);
+
+  if (c->status == 0 && rs_csv_delimiter (c->csv) != EOF)
+    {
+      proto = rs_csv_clone (c->csv);
+      if (proto == NULL)
+	{
+	  status = RS_CSV_SYSTEM_ERROR;
+	  err = errno;
+
+	  goto done;
+	}
+    }
+
+  /* K is the index of the chunk to be checked and M is the number of
+     chunks placed so far.  Chunk K is at index K modulo WINDOW in the
+     array of chunks.  NEXT is the index of the start of the next
+     chunk in the array of bounds.  */
+  k = 0;
+  m = 1;
+
+  while (1)
+    {
+      /* Keep WINDOW chunks in progress.  Only place further chunks
+	 if the first chunk is fine.  */
+      while (proto != NULL && m < k + window && next < bounds)
+	{
+	  n = chunk + m % window;
+
+	  /* Wait for the rows of the previous chunk in this slot to be
+	     delivered.  */
+	  finish (n, 0);
+	  if (n->ret != 0 && result == 0)
+	    result = n->ret;
+
+	  begin_chunk (n, bound[next], bound[next + 1], proto);
+	  ++next;
+
+	  order (workshop, n, parse_chunk, 0);
+
+	  ++m;
+	}
+
+      if (k == m || result != 0)
+	break;
+
+      c = chunk + k % window;
+      if (c->merged)
+	{
+	  ++k;
+	  continue;
+	}
+
+      finish (c, 0);
+
+      /* Chunk K starts at the beginning of a row.  If the chunk ends
+	 within a quoted field value, the parser runs out of characters.
+	 Then extend the chunk to twice its size and continue parsing
+	 after the last complete row.  A parse error before the end of
+	 the chunk is final.  The first chunk is extended, too, until
+	 it fixes the delimiter character.  */
+      j = k + 1;
+
+      while (c->end < end
+	     && ((c->status == RS_CSV_PARSE_ERROR && c->rest == 0)
+		 || (proto == NULL && c->status == 0
+		     && rs_csv_delimiter (c->csv) == EOF)))
+	{
+	  size = 2 * (size_t) (c->end - c->start);
+
+	  while (c->end < end && (size_t) (c->end - c->start) < size)
+	    {
+	      if (j < m)
+		{
+		  n = chunk + j % window;
+
+		  finish (n, 1);
+
+		  n->merged = 1;
+		  c->end = n->end;
+
+		  ++j;
+		}
+	      else
+		{
+		  c->end = bound[next + 1];
+		  ++next;
+		}
+	    }
+
+	  parse_chunk (c);
+	}
+
+      /* Fix the row index and line number.  */
+      c->row_base = row_base;
+      c->line_base = line_base;
+
+      row_base += (int) c->row_count;
+      line_base += c->line - 1;
+
+      if (c->status != 0)
+	{
+	  status = c->status;
+	  err = c->err;
+	}
+
+      c->fun = fun;
+      c->arg = arg;
+
+      if (options->unordered && status == 0)
+	order (workshop, c, deliver_chunk, 1);
+      else
+	{
+	  deliver_chunk (c);
+	  if (c->ret != 0 && result == 0)
+	    result = c->ret;
+	}
+
+      if (status != 0 || result != 0)
+	break;
+
+      /* The first chunk has been extended.  */
+      if (proto == NULL)
+	{
+	  proto = rs_csv_clone (c->csv);
+	  if (proto == NULL)
+	    {
+	      status = RS_CSV_SYSTEM_ERROR;
+	      err = errno;
+	      break;
+	    }
+	}
+
+      ++k;
+    }
+
+ done:
+
+  for (k = 0; k < window; ++k)
+    {
+      c = chunk + k;
+
+      /* Pending deliveries are only cancelled if the call-back
+	 function wants to stop.  */
+      finish (c, result != 0 || ! c->delivery);
+      if (c->delivery && c->ret != 0 && result == 0)
+	result = c->ret;
+
+      if (c->csv != NULL)
+	rs_csv_delete (c->csv);
+
+      free (c->row);
+      free (c->field);
+      free (c->text);
+    }
+
+  free (chunk);
+  free (bound);
+  free (block);
+
+  if (proto != NULL)
+    rs_csv_delete (proto);
+
+  rs_csv_delete (base);
+
+  if (line != NULL)
+    *line = line_base;
+
+  if (result != 0)
+    return result;
+
+  if (status == RS_CSV_SYSTEM_ERROR)
+    errno = err;
+
+  return status;
+}
@@ -0,0 +1,160 @@
+/* rs-csv-parallel.h --- parallel reader for comma-separated values files
+
+   Copyright (C) 2010 Ralph Schleicher
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+      * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+
+      * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in
+        the documentation and/or other materials provided with the
+        distribution.
+
+      * Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived
+        from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.  */
+
+#ifndef RS_CSV_PARALLEL_H
+#define RS_CSV_PARALLEL_H
+
+#include <stddef.h>
+
+#include "rs-csv.h"
+#include "rs-workshop.h"
+
+#ifdef __cplusplus
+#define RS_CSV_PARALLEL_BEGIN_DECL extern "C" {
+#define RS_CSV_PARALLEL_END_DECL }
+#else /* not __cplusplus */
+#define RS_CSV_PARALLEL_BEGIN_DECL
+#define RS_CSV_PARALLEL_END_DECL
+#endif /* not __cplusplus */
+
+RS_CSV_PARALLEL_BEGIN_DECL
+
+/* Options for parsing in parallel.  */
+typedef struct rs_csv_parallel_options rs_csv_parallel_options_t;
+
+struct rs_csv_parallel_options
+  {
+    /* Approximate number of characters of a chunk.  A chunk always
+       ends at the end of a line.  A value of zero means to choose
+       a default, which is one mebibyte.  */
+    size_t chunk_size;
+
+    /* Maximum number of chunks in progress.  The parsed rows of these
+       chunks are kept in memory.  A value of zero means to choose a
+       default, which is 64.  */
+    size_t window;
+
+    /* Non-zero means that rows may be delivered in any order.  See
+       ‘rs_csv_parse_parallel’.  */
+    int unordered;
+  };
+
+/* Initialize the options for parsing in parallel.
+
+   Argument OPTIONS is a pointer to an options object.
+
+   All options are set to their default value.  */
+extern void rs_csv_parallel_options_init (rs_csv_parallel_options_t *__options);
+
+/* Parse the memory buffer of a CSV object in parallel.
+
+   First argument OBJ is a pointer to a CSV object.
+   Second argument WORKSHOP is a pointer to a thread pool object.
+   Third argument OPTIONS is a pointer to an options object.  A null
+    pointer means to use the default options.
+   Fourth argument FUN is the address of a function to be called for
+    each row.  The arguments of FUN are the row index (zero based),
+    the line number after the row, the address of the row buffer,
+    the array of fields, the number of fields, and ARG.  The row
+    buffer and the fields have the same meaning as for the
+    ‘rs_csv_parse_row’ function.  They are only valid while FUN runs.
+    If FUN returns a non-zero value, parsing stops.
+   Fifth argument ARG is the argument for the call-back function.
+   Sixth argument LINE is the address of a variable.  If it is not
+    a null pointer, it is set to the line number where parsing
+    stopped.
+
+   Parses the characters of the memory buffer set by ‘rs_csv_set_buffer’
+   or ‘rs_csv_map_file’ which are not yet parsed.  OBJ must not be in
+   the middle of a row, i.e. either no field has been parsed so far,
+   the last parsed field is at the end of a row, or the parser is at
+   the end of the buffer.  The settings of OBJ apply, and the row index
+   and line number continue from the values of OBJ.  The state of OBJ
+   itself is not modified.
+
+   The memory buffer is split into chunks which are parsed concurrently
+   by the workers of WORKSHOP.  First, the workers count the quote
+   characters of each block of ‘chunk_size’ characters.  Combining the
+   parities of the blocks tells for each end of line character whether
+   it is inside a quoted field value.  A chunk starts after the first
+   end of line character of a block which is outside of a quoted field
+   value.  This assumes that quote characters only occur in quoted
+   field values.  If there are multiple quote characters, every end of
+   line character is assumed to be outside of a quoted field value.
+
+   Chunks are checked in order.  If a chunk ends within a quoted field
+   value because the assumption is wrong, the chunk is extended to
+   twice its size and the calling thread continues parsing after the
+   last complete row of the chunk.  Thus, the rows are always the same
+   as with ‘rs_csv_parse_row’.  In the worst case, e.g. a quote
+   character in an unquoted field value or an unterminated quoted
+   field value, the rest of the buffer is parsed by the calling
+   thread.  Then parsing takes a small constant factor longer than
+   with ‘rs_csv_parse_row’.
+
+   The first chunk is parsed before the others.  If there are multiple
+   delimiter characters, the first chunk is extended until it fixes
+   the delimiter character, which then applies to the rest of the
+   buffer.  If the buffer contains no delimiter character at all, the
+   whole buffer is parsed by the calling thread.
+
+   If the ‘unordered’ option is zero, FUN is called by the calling
+   thread for one row after the other.  Otherwise, FUN is called by
+   the workers of WORKSHOP for the rows of a chunk as soon as the chunk
+   is checked.  Then FUN is called concurrently and rows of different
+   chunks are delivered in any order.  The row index and line number
+   are correct in either case.  If FUN returns a non-zero value, rows
+   of other chunks may still be delivered in unordered mode.
+
+   Return value is zero if all rows are parsed.  Otherwise, the return
+   value is ‘RS_CSV_PARSE_ERROR’ for a parse error, ‘RS_CSV_SYSTEM_ERROR’
+   for a system error, or the non-zero return value of FUN.  In case
+   of a parse error, all rows before the erroneous row are delivered.
+   In case of a system error, ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        OBJ does not parse a memory buffer or OBJ is in the middle
+        of a row.
+
+   ENOMEM
+        The system ran out of memory.
+
+   If WORKSHOP rejects a work order, the calling thread does the
+   work itself.  */
+extern int rs_csv_parse_parallel (rs_csv_t *__obj, rs_workshop_t *__workshop, rs_csv_parallel_options_t const *__options, int (*__fun) (int, int, char const *, rs_csv_field_t const *, size_t, void *), void *__arg, int *__line);
+
+RS_CSV_PARALLEL_END_DECL
+
+#endif /* not RS_CSV_PARALLEL_H */
@@ -35,12 +35,47 @@
 #include <config.h>
 #endif
 
+#include <stddef.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
 #include <ctype.h>
 
+#ifdef _WIN32
+#ifndef HAVE_MMAP
+#define HAVE_MMAP 0
+#endif
+#else /* not _WIN32 */
+#ifndef HAVE_MMAP
+#define HAVE_MMAP 1
+#endif
+#endif /* not _WIN32 */
+
+#if HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Vector instructions for scanning the input, see ‘scan’.  */
+#if defined (__AVX2__)
+#include <immintrin.h>
+#define SCAN_VECTOR 32
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCAN_VECTOR 16
+#else /* not SSE2 */
+#define SCAN_VECTOR 0
+#endif /* not SSE2 */
+
+#if SCAN_VECTOR && defined (_MSC_VER)
+#include <intrin.h>
+#endif
+
 #include "rs-csv.h"
 
 #ifdef __GNUC__
@@ -69,6 +104,9 @@ do									\
   }									\
 while (0)
 
+/* Number of characters read at once.  */
+#define INPUT_SIZE 65536
+
 /* Parser states other than status codes.  */
 enum
   {
@@ -103,6 +141,12 @@ struct rs_csv
     size_t val_len;
     char *val_end;
 
+    /* If VAL_VIEW is not a null pointer, the field value is not in
+       the buffer but the VAL_LEN characters starting at VAL_VIEW in
+       the memory buffer of the parser.  The field value is copied
+       into the buffer on demand, see ‘rs_csv_value’.  */
+    char const *val_view;
+
     /* The actual delimiter character.  A value of ‘EOF’ means that
        the delimiter is undefined.  */
     int delim;
@@ -130,8 +174,60 @@ struct rs_csv
     /* Sequence of start characters for a line comment.  */
     char *comment_seq;
     char comment_buf[8];
+
+    /* Set of characters terminating a simple field value, see
+       ‘scan_simple’.  A value of zero for STOP_COUNT means that the
+       set has to be recomputed.  A negative value means that the set
+       is too large for scanning.  */
+    int stop_count;
+    unsigned char stop_seq[12];
+
+    /* Input buffer.  The parser reads characters from IN_STREAM in
+       blocks of IN_SIZE characters.  IN_PTR points to the next
+       character and IN_END points to the end of the characters
+       read so far.  If IN_STREAM is a null pointer, IN_PTR and IN_END
+       point into a memory buffer provided by the user, see
+       ‘rs_csv_set_buffer’.  */
+    FILE *in_stream;
+    size_t in_size;
+    char *in_buf;
+    char const *in_ptr;
+    char const *in_end;
+
+    /* Contents of a file, see ‘rs_csv_map_file’.  */
+    void *map_addr;
+    size_t map_len;
+
+    /* Row buffer, see ‘rs_csv_parse_row’.  The field values of a row
+       are stored one after another, each followed by a terminating
+       null character.  ROW_LEN is the number of characters used.  */
+    size_t row_size;
+    size_t row_len;
+    char *row_buf;
+
+    /* Fields of a row.  FIELD_SIZE is the number of elements of the
+       array.  */
+    size_t field_size;
+    rs_csv_field_t *field;
   };
 
+/* Release the contents of a file, see ‘rs_csv_map_file’.  */
+static void
+unmap_file (rs_csv_t *obj)
+{
+  if (obj->map_addr != NULL)
+    {
+#if HAVE_MMAP
+      munmap (obj->map_addr, obj->map_len);
+#else /* not HAVE_MMAP */
+      free (obj->map_addr);
+#endif /* not HAVE_MMAP */
+    }
+
+  obj->map_addr = NULL;
+  obj->map_len = 0;
+}
+
 /* Create a CSV object.  */
 rs_csv_t *
 rs_csv_new (void)
@@ -151,6 +247,7 @@ rs_csv_new (void)
       obj->val_buf = NULL;
       obj->val_len = 0;
       obj->val_end = NULL;
+      obj->val_view = NULL;
       obj->delim = EOF;
       obj->delim_count = 1;
       obj->delim_seq = memcpy (obj->delim_buf, ",", obj->delim_count);
@@ -158,6 +255,19 @@ rs_csv_new (void)
       obj->quote_seq = memcpy (obj->quote_buf, "\"", obj->quote_count);
       obj->comment_count = 0;
       obj->comment_seq = memcpy (obj->comment_buf, "", obj->comment_count);
+      obj->stop_count = 0;
+      obj->in_stream = NULL;
+      obj->in_size = 0;
+      obj->in_buf = NULL;
+      obj->in_ptr = NULL;
+      obj->in_end = NULL;
+      obj->map_addr = NULL;
+      obj->map_len = 0;
+      obj->row_size = 0;
+      obj->row_len = 0;
+      obj->row_buf = NULL;
+      obj->field_size = 0;
+      obj->field = NULL;
     }
 
   return obj;
@@ -182,9 +292,208 @@ rs_csv_delete (rs_csv_t *obj)
   if (obj->comment_seq != obj->comment_buf)
     free (obj->comment_seq);
 
+  if (obj->in_buf != NULL)
+    free (obj->in_buf);
+
+  unmap_file (obj);
+
+  if (obj->row_buf != NULL)
+    free (obj->row_buf);
+
+  if (obj->field != NULL)
+    free (obj->field);
+
   free (obj);
 }
 
+/* Create a CSV object with the same settings.  */
+rs_csv_t *
+rs_csv_clone (rs_csv_t const *obj)
+{
+  rs_csv_t *copy;
+
+  copy = rs_csv_new ();
+  if (copy != NULL)
+    {
+      copy->delim = obj->delim;
+      copy->delim_count = obj->delim_count;
+      memcpy (copy->delim_seq, obj->delim_seq, obj->delim_count);
+      copy->quote_count = obj->quote_count;
+      memcpy (copy->quote_seq, obj->quote_seq, obj->quote_count);
+      copy->comment_count = obj->comment_count;
+      memcpy (copy->comment_seq, obj->comment_seq, obj->comment_count);
+    }
+
+  return copy;
+}
+
+/* Parse the characters of a memory buffer.  */
+int
+rs_csv_set_buffer (rs_csv_t *obj, char const *buf, size_t len)
+{
+  if (buf == NULL && len != 0)
+    set_errno_and_return_value (EINVAL, -1);
+
+  /* Switching the input in the middle of a row would splice the
+     rows of both inputs.  */
+  if (obj->state == FS)
+    set_errno_and_return_value (EBUSY, -1);
+
+  unmap_file (obj);
+
+  /* An empty buffer is still a buffer.  */
+  if (buf == NULL)
+    buf = "";
+
+  obj->in_stream = NULL;
+  obj->in_ptr = buf;
+  obj->in_end = buf + len;
+
+  /* Start over.  */
+  obj->line = 1;
+  obj->row = -1;
+  obj->col = -1;
+  obj->state = NL;
+  obj->err = 0;
+
+  if (obj->val_buf != NULL)
+    obj->val_buf[0] = 0;
+
+  obj->val_len = 0;
+  obj->val_end = NULL;
+  obj->val_view = NULL;
+
+  return 0;
+}
+
+/* Return the characters of the memory buffer not yet parsed.  */
+char const *
+rs_csv_buffer (rs_csv_t *obj, size_t *len)
+{
+  if (obj->in_stream != NULL || obj->in_ptr == NULL)
+    {
+      *len = 0;
+      return NULL;
+    }
+
+  *len = obj->in_end - obj->in_ptr;
+  return obj->in_ptr;
+}
+
+/* Parse the contents of a file.  */
+int
+rs_csv_map_file (rs_csv_t *obj, char const *file_name)
+{
+  void *addr = NULL;
+  size_t len = 0;
+
+  if (file_name == NULL)
+    set_errno_and_return_value (EINVAL, -1);
+
+  if (obj->state == FS)
+    set_errno_and_return_value (EBUSY, -1);
+
+#if HAVE_MMAP
+  {
+    struct stat st;
+    int fd, e;
+
+    fd = open (file_name, O_RDONLY);
+    if (fd < 0)
+      return -1;
+
+    if (fstat (fd, &st) != 0)
+      goto close_fd;
+
+    if (st.st_size < 0 || (unsigned long long) st.st_size > (size_t) -1)
+      {
+	errno = EFBIG;
+	goto close_fd;
+      }
+
+    len = (size_t) st.st_size;
+
+    /* An empty file can not be mapped.  */
+    if (len > 0)
+      {
+	addr = mmap (NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED)
+	  goto close_fd;
+
+#ifdef MADV_SEQUENTIAL
+	/* The parser reads the file from start to end.  */
+	madvise (addr, len, MADV_SEQUENTIAL);
+#endif
+      }
+
+    close (fd);
+    goto done;
+
+  close_fd:
+
+    e = errno;
+    close (fd);
+    errno = e;
+
+    return -1;
+  }
+#else /* not HAVE_MMAP */
+  {
+    FILE *stream;
+    size_t n = 0;
+
+    /* Read the whole file into memory.  */
+    stream = fopen (file_name, "rb");
+    if (stream == NULL)
+      return -1;
+
+    while (1)
+      {
+	if (len == n)
+	  {
+	    void *p;
+
+	    n = (len > 0 ? 2 * len : INPUT_SIZE);
+
+	    p = realloc (addr, n);
+	    if (p == NULL)
+	      goto failure;
+
+	    addr = p;
+	  }
+
+	len += fread ((char *) addr + len, 1, n - len, stream);
+	if (len < n)
+	  {
+	    if (ferror (stream))
+	      goto failure;
+
+	    break;
+	  }
+      }
+
+    fclose (stream);
+    goto done;
+
+  failure:
+
+    free (addr);
+    fclose (stream);
+
+    return -1;
+  }
+#endif /* not HAVE_MMAP */
+
+ done:
+
+  rs_csv_set_buffer (obj, addr, len);
+
+  obj->map_addr = addr;
+  obj->map_len = len;
+
+  return 0;
+}
+
 /* Customize the delimiter characters.  */
 int
 rs_csv_set_delimiter (rs_csv_t *obj, char const *seq, size_t count)
@@ -222,9 +531,22 @@ rs_csv_set_delimiter (rs_csv_t *obj, char const *seq, size_t count)
 		obj->delim_seq[0] :
 		EOF);
 
+  /* Invalidate the scanner.  */
+  obj->stop_count = 0;
+
   return 0;
 }
 
+/* Return the actual delimiter character.  */
+int
+rs_csv_delimiter (rs_csv_t const *obj)
+{
+  if (obj->delim_count == 0)
+    return 0;
+
+  return obj->delim;
+}
+
 /* Customize the quote start characters.  */
 int
 rs_csv_set_quote_start (rs_csv_t *obj, char const *seq, size_t count)
@@ -260,6 +582,14 @@ rs_csv_set_quote_start (rs_csv_t *obj, char const *seq, size_t count)
   return 0;
 }
 
+/* Return the quote start characters.  */
+char const *
+rs_csv_quote_start (rs_csv_t const *obj, size_t *count)
+{
+  *count = obj->quote_count;
+  return obj->quote_seq;
+}
+
 /* Customize the comment start characters.  */
 int
 rs_csv_set_comment_start (rs_csv_t *obj, char const *seq, size_t count)
@@ -299,30 +629,79 @@ rs_csv_set_comment_start (rs_csv_t *obj, char const *seq, size_t count)
  * The Parser
  */
 
-static_inline int
-get_char (rs_csv_t *obj, FILE *stream)
+/* Read the next block of characters from STREAM into the input
+   buffer.  Return value is the first character of the block or ‘EOF’
+   if there are no more characters.  */
+static int
+fill_buffer (rs_csv_t *obj, FILE *stream)
 {
-  int c;
+  size_t n;
+
+  /* A memory buffer is not refilled.  */
+  if (stream == NULL)
+    return EOF;
+
+  if (obj->in_buf == NULL)
+    {
+      obj->in_buf = malloc (INPUT_SIZE);
+      if (obj->in_buf == NULL)
+	{
+	  if (obj->err == 0)
+	    obj->err = errno;
+
+	  return EOF;
+	}
+
+      obj->in_size = INPUT_SIZE;
+    }
 
   while (1)
     {
-      c = getc (stream);
-      if (c != EOF)
-	return c;
+      n = fread (obj->in_buf, 1, obj->in_size, stream);
+      if (n > 0)
+	{
+	  obj->in_ptr = obj->in_buf;
+	  obj->in_end = obj->in_buf + n;
+
+	  return (unsigned char) *obj->in_ptr++;
+	}
+
+      obj->in_ptr = obj->in_end = obj->in_buf;
+
+      if (! ferror (stream))
+	return EOF;
 
       if (errno == EINTR)
 	{
+	  clearerr (stream);
 	  errno = 0;
 	  continue;
 	}
 
-      if (errno != 0 && obj->err == 0)
-	obj->err = errno;
+      if (obj->err == 0)
+	obj->err = (errno != 0 ? errno : EIO);
 
       return EOF;
     }
 }
 
+static_inline int
+get_char (rs_csv_t *obj, FILE *stream)
+{
+  if (obj->in_ptr < obj->in_end)
+    return (unsigned char) *obj->in_ptr++;
+
+  return fill_buffer (obj, stream);
+}
+
+/* Push back the character C most recently read by ‘get_char’.  */
+static_inline void
+unget_char (rs_csv_t *obj, int c)
+{
+  if (c != EOF)
+    --obj->in_ptr;
+}
+
 /* Return true if C is a delimiter character.
 
    Argument C should not be an end of line character!  */
@@ -344,6 +723,9 @@ delimiterp (rs_csv_t *obj, int c)
 	return 0;
 
       obj->delim = *p;
+
+      /* Other delimiter characters are no longer special.  */
+      obj->stop_count = 0;
     }
 
   return (c == obj->delim);
@@ -372,50 +754,277 @@ end_of_line_p (int c)
   return (c == EOF || c == '\n' || c == '\r');
 }
 
+/* Return the index of the least significant bit set in the
+   non-zero bit mask M.  */
+#if SCAN_VECTOR
+static_inline int
+first_bit (unsigned int m)
+{
+#if defined (__GNUC__)
+  return __builtin_ctz (m);
+#elif defined (_MSC_VER)
+  unsigned long k;
+
+  _BitScanForward (&k, m);
+  return (int) k;
+#else /* not _MSC_VER */
+  int k;
+
+  for (k = 0; (m & 1U) == 0; m >>= 1)
+    ++k;
+
+  return k;
+#endif /* not _MSC_VER */
+}
+#endif /* SCAN_VECTOR */
+
+/* Find the first member of a character set.
+
+   First argument P is the start of the input.
+   Second argument END is the end of the input.
+   Third argument SEQ is the sequence of characters.
+   Fourth argument COUNT is the number of characters in SEQ.
+
+   Return value is the address of the first character in the range
+   from P up to but excluding END which is a member of the character
+   set.  If there is no such character, value is END.
+
+   Large inputs are examined one block at a time.  The comparisons
+   of a block against the characters of the set are combined into a
+   bit mask of the matching positions so that the loop only has to
+   branch once per block.  With SSE2 or AVX2 the block size is 16 or
+   32 characters.  Otherwise, the block is a machine word which is
+   tested for matching bytes without looking at individual bytes.  */
+static_inline char const *
+scan (char const *p, char const *end, unsigned char const *seq, int count)
+{
+  int k;
+
+#if SCAN_VECTOR >= 32
+  while (end - p >= 32)
+    {
+      __m256i v, m;
+      unsigned int mask;
+
+      v = _mm256_loadu_si256 ((__m256i const *) p);
+      m = _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ((char) seq[0]));
+      for (k = 1; k < count; ++k)
+	m = _mm256_or_si256 (m, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ((char) seq[k])));
+
+      mask = (unsigned int) _mm256_movemask_epi8 (m);
+      if (mask != 0)
+	return p + first_bit (mask);
+
+      p += 32;
+    }
+#endif /* SCAN_VECTOR >= 32 */
+
+#if SCAN_VECTOR >= 16
+  while (end - p >= 16)
+    {
+      __m128i v, m;
+      unsigned int mask;
+
+      v = _mm_loadu_si128 ((__m128i const *) p);
+      m = _mm_cmpeq_epi8 (v, _mm_set1_epi8 ((char) seq[0]));
+      for (k = 1; k < count; ++k)
+	m = _mm_or_si128 (m, _mm_cmpeq_epi8 (v, _mm_set1_epi8 ((char) seq[k])));
+
+      mask = (unsigned int) _mm_movemask_epi8 (m);
+      if (mask != 0)
+	return p + first_bit (mask);
+
+      p += 16;
+    }
+#else /* not SCAN_VECTOR */
+  while (end - p >= (ptrdiff_t) sizeof (size_t))
+    {
+      /* A word with all bytes set to one and a word with the most
+	 significant bit of all bytes set.  */
+      size_t const ones = (size_t) -1 / 255;
+      size_t const high = ones * 128;
+      size_t v, x, mask;
+
+      memcpy (&v, p, sizeof (size_t));
+
+      /* A byte of X is zero if the byte of V matches.  Only a zero
+	 byte sets the most significant bit in (X - ONES) & ~X without
+	 a preceding match.  */
+      mask = 0;
+      for (k = 0; k < count; ++k)
+	{
+	  x = v ^ (ones * seq[k]);
+	  mask |= (x - ones) & ~x & high;
+	}
+
+      if (mask != 0)
+	break;
+
+      p += sizeof (size_t);
+    }
+#endif /* not SCAN_VECTOR */
+
+  for (; p < end; ++p)
+    {
+      for (k = 0; k < count; ++k)
+	{
+	  if ((unsigned char) *p == seq[k])
+	    return p;
+	}
+    }
+
+  return end;
+}
+
+/* Compute the set of characters terminating a simple field value.  */
+static void
+update_stop (rs_csv_t *obj)
+{
+  int n, c;
+
+  n = 0;
+  obj->stop_seq[n++] = '\n';
+  obj->stop_seq[n++] = '\r';
+
+  if (obj->delim_count == 0)
+    {
+      /* Whitespace characters depend on the locale.  */
+      for (c = 0; c <= UCHAR_MAX; ++c)
+	{
+	  if (c == '\n' || c == '\r' || ! isspace (c))
+	    continue;
+
+	  if (n == sizeof (obj->stop_seq))
+	    {
+	      obj->stop_count = -1;
+	      return;
+	    }
+
+	  obj->stop_seq[n++] = c;
+	}
+    }
+  else if (obj->delim == EOF)
+    {
+      size_t k;
+
+      for (k = 0; k < obj->delim_count; ++k)
+	obj->stop_seq[n++] = obj->delim_seq[k];
+    }
+  else
+    obj->stop_seq[n++] = obj->delim;
+
+  obj->stop_count = n;
+}
+
+/* Find the end of a simple field value, i.e. the next delimiter or
+   end of line character.
+
+   Second argument P is the start of the input.
+   Third argument END is the end of the input.
+
+   Return value is the address of the character terminating the
+   field value or END.  */
+static_inline char const *
+scan_simple (rs_csv_t *obj, char const *p, char const *end)
+{
+  int c;
+
+  if (obj->stop_count == 0)
+    update_stop (obj);
+
+  if (obj->stop_count > 0)
+    return scan (p, end, obj->stop_seq, obj->stop_count);
+
+  for (; p < end; ++p)
+    {
+      c = (unsigned char) *p;
+
+      if (c == '\n' || c == '\r' || delimiterp (obj, c))
+	break;
+    }
+
+  return p;
+}
+
 static_inline void
 begin_value (rs_csv_t *obj)
 {
+  /* Only the terminating null character is cleared.  Thus,
+     the cost of a field is proportional to its length.  */
   if (obj->val_buf != NULL)
-    memset (obj->val_buf, 0, obj->val_size);
+    obj->val_buf[0] = 0;
 
   obj->val_len = 0;
   obj->val_end = NULL;
+  obj->val_view = NULL;
 }
 
-static_inline int
-add_char (rs_csv_t *obj, int c)
+/* Enlarge the buffer for the field value so that there is room
+   for at least COUNT characters plus the terminating null character.
+   The buffer size is doubled to keep the number of reallocations
+   logarithmic in the field length.  */
+static int
+grow_value (rs_csv_t *obj, size_t count)
 {
-  /* Check for room.  Reserve space for the terminating null
-     character.  */
-  if (obj->val_len + 1 >= obj->val_size)
-    {
-      size_t n;
-      char *p;
-
-      /* New buffer size.  */
-      n = obj->val_size + BUFSIZ;
+  size_t n;
+  char *p;
 
-      p = (obj->val_buf == NULL ? malloc (n) : realloc (obj->val_buf, n));
-      if (p == NULL)
+  /* New buffer size.  */
+  n = (obj->val_size > 0 ? obj->val_size : BUFSIZ);
+  while (obj->val_len + count >= n)
+    {
+      if (n > (size_t) -1 / 2)
 	{
 	  if (obj->err == 0)
-	    obj->err = errno;
+	    obj->err = ENOMEM;
 
 	  return RS_CSV_SYSTEM_ERROR;
 	}
 
-      obj->val_size = n;
-      obj->val_buf = p;
+      n *= 2;
+    }
+
+  p = (obj->val_buf == NULL ? malloc (n) : realloc (obj->val_buf, n));
+  if (p == NULL)
+    {
+      if (obj->err == 0)
+	obj->err = errno;
+
+      return RS_CSV_SYSTEM_ERROR;
+    }
+
+  obj->val_size = n;
+  obj->val_buf = p;
+
+  return 0;
+}
+
+/* Make room for adding COUNT characters to the field value.  */
+static_inline int
+reserve_value (rs_csv_t *obj, size_t count)
+{
+  /* Check for room.  Reserve space for the terminating null
+     character.  */
+  if (obj->val_len + count >= obj->val_size)
+    {
+      if (grow_value (obj, count) != 0)
+	return RS_CSV_SYSTEM_ERROR;
 
       /* Relocate buffer position.  */
       obj->val_end = obj->val_buf + obj->val_len;
-
-      /* Clear newly allocated area.  */
-      memset (obj->val_end, 0, obj->val_size - obj->val_len);
     }
   else if (obj->val_end == NULL)
     obj->val_end = obj->val_buf + obj->val_len;
 
+  return 0;
+}
+
+static_inline int
+add_char (rs_csv_t *obj, int c)
+{
+  if (reserve_value (obj, 1) != 0)
+    return RS_CSV_SYSTEM_ERROR;
+
   /* Add the character.  */
   *obj->val_end = c;
 
@@ -426,25 +1035,43 @@ add_char (rs_csv_t *obj, int c)
   return 0;
 }
 
+/* Add COUNT characters starting at STR to the field value.  */
+static_inline int
+add_chars (rs_csv_t *obj, char const *str, size_t count)
+{
+  if (count == 0)
+    return 0;
+
+  if (reserve_value (obj, count) != 0)
+    return RS_CSV_SYSTEM_ERROR;
+
+  memcpy (obj->val_end, str, count);
+
+  /* Adjust field length.  */
+  obj->val_len += count;
+  obj->val_end += count;
+
+  return 0;
+}
+
 static_inline void
 end_value (rs_csv_t *obj, int trim)
 {
-  /* Terminate field value.  */
-  if (obj->val_end != NULL)
-    *obj->val_end = 0;
+  if (obj->val_end == NULL)
+    return;
 
   /* Trim trailing spaces.  */
   if (trim != 0)
     {
-      while (obj->val_len > 0 && isspace (obj->val_end[-1]))
+      while (obj->val_len > 0 && isspace ((unsigned char) obj->val_end[-1]))
 	{
 	  --obj->val_len;
 	  --obj->val_end;
-
-	  /* Clear trimmed area.  */
-	  *obj->val_end = 0;
 	}
-   }
+    }
+
+  /* Terminate field value.  */
+  *obj->val_end = 0;
 }
 
 static_inline int
@@ -457,7 +1084,7 @@ parse_end_of_line (rs_csv_t *obj, FILE *stream, int c)
       /* Mac or DOS style end of line character.  */
       c = get_char (obj, stream);
       if (c != '\n')
-	ungetc (c, stream);
+	unget_char (obj, c);
 
       fall_through;
 
@@ -482,21 +1109,54 @@ parse_end_of_line (rs_csv_t *obj, FILE *stream, int c)
 static_inline int
 parse_simple (rs_csv_t *obj, FILE *stream, int c)
 {
+  char const *p;
+
+  /* When parsing a memory buffer, the field value is a view
+     into the buffer.  */
+  if (stream == NULL)
+    {
+      char const *start = obj->in_ptr - 1;
+
+      p = scan_simple (obj, obj->in_ptr, obj->in_end);
+      obj->in_ptr = p;
+
+      /* Trim trailing spaces.  */
+      while (p > start && isspace ((unsigned char) p[-1]))
+	--p;
+
+      obj->val_view = start;
+      obj->val_len = p - start;
+
+      return 0;
+    }
+
+  if (add_char (obj, c) != 0)
+    return RS_CSV_SYSTEM_ERROR;
+
   while (1)
     {
-      if (add_char (obj, c) != 0)
+      /* Scan the buffered characters up to the end of the field.  */
+      p = scan_simple (obj, obj->in_ptr, obj->in_end);
+
+      if (add_chars (obj, obj->in_ptr, p - obj->in_ptr) != 0)
 	return RS_CSV_SYSTEM_ERROR;
 
-      c = get_char (obj, stream);
+      obj->in_ptr = p;
 
-      if (end_of_line_p (c) || delimiterp (obj, c))
-	{
-	  ungetc (c, stream);
-	  end_value (obj, 1);
+      if (p < obj->in_end)
+	break;
 
-	  return 0;
-	}
+      /* Buffer is exhausted.  */
+      c = fill_buffer (obj, stream);
+      if (c == EOF)
+	break;
+
+      unget_char (obj, c);
     }
+
+  end_value (obj, 1);
+
+  return 0;
 }
 
 /* Parse a quoted field value.
@@ -507,10 +1167,64 @@ parse_simple (rs_csv_t *obj, FILE *stream, int c)
 static_inline int
 parse_quoted (rs_csv_t *obj, FILE *stream, int q)
 {
+  unsigned char seq[3];
+  char const *p;
   int c;
 
+  /* Characters terminating a run of ordinary characters.  */
+  seq[0] = q;
+  seq[1] = '\n';
+  seq[2] = '\r';
+
+  /* When parsing a memory buffer, the field value is a view into
+     the buffer unless it contains an escaped quote character or a
+     carriage return which have to be replaced.  */
+  if (stream == NULL)
+    {
+      char const *start = obj->in_ptr;
+      int lines = 0;
+
+      for (p = start; (p = scan (p, obj->in_end, seq, 3)) < obj->in_end; ++p)
+	{
+	  c = (unsigned char) *p;
+
+	  if (c == q || c == '\r')
+	    break;
+
+	  ++lines;
+	}
+
+      if (p < obj->in_end && (unsigned char) p[0] == q
+	  && (p + 1 == obj->in_end || (unsigned char) p[1] != q))
+	{
+	  obj->in_ptr = p + 1;
+	  obj->line += lines;
+
+	  /* Like an empty quoted field value read from a stream,
+	     an empty view is a null value.  */
+	  if (p > start)
+	    {
+	      obj->val_view = start;
+	      obj->val_len = p - start;
+	    }
+
+	  return 0;
+	}
+
+      /* Otherwise, copy the field value.  */
+    }
+
   while (1)
     {
+      /* Scan the buffered characters up to the next quote or end
+	 of line character.  */
+      p = scan (obj->in_ptr, obj->in_end, seq, 3);
+
+      if (add_chars (obj, obj->in_ptr, p - obj->in_ptr) != 0)
+	return RS_CSV_SYSTEM_ERROR;
+
+      obj->in_ptr = p;
+
       c = get_char (obj, stream);
       if (c == EOF)
 	return RS_CSV_PARSE_ERROR;
@@ -520,7 +1234,7 @@ parse_quoted (rs_csv_t *obj, FILE *stream, int q)
 	  c = get_char (obj, stream);
 	  if (c != q)
 	    {
-	      ungetc (c, stream);
+	      unget_char (obj, c);
 	      end_value (obj, 0);
 
 	      return 0;
@@ -557,6 +1271,13 @@ rs_csv_parse (rs_csv_t *obj, FILE *stream)
   e = errno;
   errno = 0;
 
+  /* Discard buffered characters of another stream.  */
+  if (stream != obj->in_stream)
+    {
+      obj->in_stream = stream;
+      obj->in_ptr = obj->in_end = obj->in_buf;
+    }
+
   /* Clear field value.  */
   begin_value (obj);
 
@@ -606,7 +1327,7 @@ rs_csv_parse (rs_csv_t *obj, FILE *stream)
 	    goto new_line;
 	}
 
-      ungetc (c, stream);
+      unget_char (obj, c);
 
       /* Next row.  */
       ++obj->row;
@@ -662,7 +1383,7 @@ rs_csv_parse (rs_csv_t *obj, FILE *stream)
 
 		  if (end_of_line_p (c) || ! isspace (c))
 		    {
-		      ungetc (c, stream);
+		      unget_char (obj, c);
 		      break;
 		    }
 		}
@@ -691,6 +1412,10 @@ rs_csv_parse (rs_csv_t *obj, FILE *stream)
 	break;
     }
 
+  /* Terminate a partial field value, too.  */
+  if (obj->val_end != NULL)
+    *obj->val_end = 0;
+
   /* Save parser state.  */
   obj->state = (obj->err == 0 ? op : RS_CSV_SYSTEM_ERROR);
 
@@ -711,6 +1436,136 @@ rs_csv_parse (rs_csv_t *obj, FILE *stream)
   return obj->state;
 }
 
+/* Enlarge the row buffer so that there is room for at least COUNT
+   more characters.  */
+static int
+grow_row (rs_csv_t *obj, size_t count)
+{
+  size_t n;
+  char *p;
+
+  n = (obj->row_size > 0 ? obj->row_size : BUFSIZ);
+  while (obj->row_len + count > n)
+    {
+      if (n > (size_t) -1 / 2)
+	set_errno_and_return_value (ENOMEM, -1);
+
+      n *= 2;
+    }
+
+  p = (obj->row_buf == NULL ? malloc (n) : realloc (obj->row_buf, n));
+  if (p == NULL)
+    return -1;
+
+  obj->row_size = n;
+  obj->row_buf = p;
+
+  return 0;
+}
+
+/* Enlarge the array of fields.  */
+static int
+grow_field (rs_csv_t *obj)
+{
+  size_t n;
+  rs_csv_field_t *p;
+
+  n = (obj->field_size > 0 ? obj->field_size : 16);
+  if (obj->field_size > 0)
+    {
+      if (n > (size_t) -1 / 2 / sizeof (rs_csv_field_t))
+	set_errno_and_return_value (ENOMEM, -1);
+
+      n *= 2;
+    }
+
+  p = (obj->field == NULL ?
+       malloc (n * sizeof (rs_csv_field_t)) :
+       realloc (obj->field, n * sizeof (rs_csv_field_t)));
+  if (p == NULL)
+    return -1;
+
+  obj->field_size = n;
+  obj->field = p;
+
+  return 0;
+}
+
+/* Parse the next row in a CSV file.  */
+int
+rs_csv_parse_row (rs_csv_t *obj, FILE *stream, rs_csv_field_t const **field, size_t *count)
+{
+  rs_csv_field_t *f;
+  char const *str;
+  size_t n, len;
+  int s;
+
+  n = 0;
+  obj->row_len = 0;
+
+  while (1)
+    {
+      s = rs_csv_parse (obj, stream);
+      if (s != 0)
+	break;
+
+      if (n == obj->field_size && grow_field (obj) != 0)
+	{
+	  /* Like a system error while parsing, the error is
+	     permanent.  */
+	  obj->err = errno;
+
+	  s = obj->state = RS_CSV_SYSTEM_ERROR;
+	  break;
+	}
+
+      str = rs_csv_view (obj);
+      len = obj->val_len;
+
+      /* Reserve space for the terminating null character.  */
+      if (obj->row_len + len >= obj->row_size && grow_row (obj, len + 1) != 0)
+	{
+	  obj->err = errno;
+
+	  s = obj->state = RS_CSV_SYSTEM_ERROR;
+	  break;
+	}
+
+      f = obj->field + n;
+      f->off = obj->row_len;
+      f->len = len;
+      f->null = ! rs_csv_valuep (obj);
+
+      if (len > 0)
+	memcpy (obj->row_buf + obj->row_len, str, len);
+
+      obj->row_len += len;
+      obj->row_buf[obj->row_len++] = 0;
+
+      ++n;
+
+      /* The end of a row is either the end of a line or the
+	 end of the file.  */
+      if (obj->state != FS)
+	break;
+    }
+
+  if (field != NULL)
+    *field = obj->field;
+
+  if (count != NULL)
+    *count = n;
+
+  return s;
+}
+
+/* Return the address of the row buffer.  */
+char const *
+rs_csv_row_buffer (rs_csv_t *obj)
+{
+  return obj->row_buf;
+}
+
 /* Query the status of the parser.  */
 int
 rs_csv_status (rs_csv_t *obj)
@@ -752,7 +1607,7 @@ rs_csv_column (rs_csv_t *obj)
 int
 rs_csv_valuep (rs_csv_t *obj)
 {
-  return (obj->val_end != NULL);
+  return (obj->val_end != NULL || obj->val_view != NULL);
 }
 
 /* Return the address of a character buffer with the contents
@@ -761,6 +1616,41 @@ rs_csv_valuep (rs_csv_t *obj)
 char *
 rs_csv_value (rs_csv_t *obj)
 {
+  if (obj->val_view != NULL)
+    {
+      char const *view = obj->val_view;
+      size_t len = obj->val_len;
+
+      /* Copy the field value on demand.  */
+      obj->val_view = NULL;
+      obj->val_len = 0;
+      obj->val_end = NULL;
+
+      if (add_chars (obj, view, len) != 0)
+	{
+	  /* Keep the view.  */
+	  obj->val_view = view;
+	  obj->val_len = len;
+	  obj->val_end = NULL;
+
+	  errno = ENOMEM;
+	  return NULL;
+	}
+
+      *obj->val_end = 0;
+    }
+
+  return obj->val_buf;
+}
+
+/* Return the address of the characters of the most recently
+   parsed field without copying them.  */
+char const *
+rs_csv_view (rs_csv_t *obj)
+{
+  if (obj->val_view != NULL)
+    return obj->val_view;
+
   return obj->val_buf;
 }
 
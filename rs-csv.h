@@ -49,6 +49,21 @@ RS_CSV_BEGIN_DECL
 /* Opaque CSV object.  */
 typedef struct rs_csv rs_csv_t;
 
+/* Field of a row, see ‘rs_csv_parse_row’.  */
+typedef struct rs_csv_field rs_csv_field_t;
+
+struct rs_csv_field
+  {
+    /* Offset of the field value in the row buffer.  */
+    size_t off;
+
+    /* Length of the field value.  */
+    size_t len;
+
+    /* Non-zero if the field value is null.  */
+    int null;
+  };
+
 /* Status codes other than zero and ‘EOF’.  */
 enum
   {
@@ -75,6 +90,21 @@ extern rs_csv_t *rs_csv_new (void);
    all references to the CSV object are void.  */
 extern void rs_csv_delete (rs_csv_t *__obj);
 
+/* Create a CSV object with the same settings.
+
+   Argument OBJ is a pointer to a CSV object.
+
+   The new CSV object has the same delimiter, quote start, and
+   comment start characters as OBJ.  If OBJ has already fixed the
+   delimiter character, see ‘rs_csv_set_delimiter’, the new CSV object
+   uses the same delimiter character.  The state of the parser is not
+   copied.
+
+   Return value is a pointer to a CSV object.  In case of an error,
+   a null pointer is returned and ‘errno’ is set to describe the
+   error.  */
+extern rs_csv_t *rs_csv_clone (rs_csv_t const *__obj);
+
 /* Customize the delimiter characters.
 
    First argument OBJ is a pointer to a CSV object.
@@ -98,6 +128,15 @@ extern void rs_csv_delete (rs_csv_t *__obj);
    The default delimiter character is ‘,’, i.e. a comma.  */
 extern int rs_csv_set_delimiter (rs_csv_t *__obj, char const *__seq, size_t __count);
 
+/* Return the actual delimiter character.
+
+   Argument OBJ is a pointer to a CSV object.
+
+   Return value is the delimiter character, zero if fields are
+   delimited by whitespace characters, or ‘EOF’ if there are multiple
+   delimiter characters and none of them has been matched so far.  */
+extern int rs_csv_delimiter (rs_csv_t const *__obj);
+
 /* Customize the quote start characters.
 
    First argument OBJ is a pointer to a CSV object.
@@ -116,6 +155,16 @@ extern int rs_csv_set_delimiter (rs_csv_t *__obj, char const *__seq, size_t __co
    The default quote character is ‘"’, i.e. double quote.  */
 extern int rs_csv_set_quote_start (rs_csv_t *__obj, char const *__seq, size_t __count);
 
+/* Return the quote start characters.
+
+   First argument OBJ is a pointer to a CSV object.
+   Second argument COUNT is the address of a variable.  It is set
+    to the number of quote start characters.
+
+   Return value is the address of the quote start characters.
+   The characters are not null-terminated.  */
+extern char const *rs_csv_quote_start (rs_csv_t const *__obj, size_t *__count);
+
 /* Customize the comment start characters.
 
    First argument OBJ is a pointer to a CSV object.
@@ -134,16 +183,106 @@ extern int rs_csv_set_quote_start (rs_csv_t *__obj, char const *__seq, size_t __
    Line comments are disabled by default.  */
 extern int rs_csv_set_comment_start (rs_csv_t *__obj, char const *__seq, size_t __count);
 
+/* Parse the characters of a memory buffer.
+
+   First argument OBJ is a pointer to a CSV object.
+   Second argument BUF is the address of the characters.
+   Third argument LEN is the number of characters.
+
+   Call ‘rs_csv_parse’ with a null pointer as the stream argument
+   to parse the characters.  The parser does not copy the characters.
+   Thus, the memory buffer has to exist while parsing.  Unquoted field
+   values and quoted field values without escaped quote characters
+   and carriage return characters are not copied either, see
+   ‘rs_csv_view’.
+
+   The parser starts over at the beginning of the buffer, i.e. the
+   line number, row index, column index, and parser state are reset
+   as for a new CSV object.  The settings of OBJ are kept, including
+   a delimiter character fixed by a previous input.
+
+   Return value is zero on success.  In case of an error, the return
+   value is -1 and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EBUSY
+        OBJ is in the middle of a row.
+
+   EINVAL
+        BUF is a null pointer and LEN is not zero.  */
+extern int rs_csv_set_buffer (rs_csv_t *__obj, char const *__buf, size_t __len);
+
+/* Parse the contents of a file.
+
+   First argument OBJ is a pointer to a CSV object.
+   Second argument FILE_NAME is the name of the file.
+
+   Maps the file into memory and calls ‘rs_csv_set_buffer’.  On
+   systems without memory-mapped files, the whole file is read into
+   memory.  The mapping is released when the CSV object is deleted
+   or when another buffer is set.
+
+   Return value is zero on success.  In case of an error, the return
+   value is -1 and ‘errno’ is set to describe the error.  */
+extern int rs_csv_map_file (rs_csv_t *__obj, char const *__file_name);
+
+/* Return the characters of the memory buffer not yet parsed.
+
+   First argument OBJ is a pointer to a CSV object.
+   Second argument LEN is the address of a variable.  It is set
+    to the number of characters.
+
+   Return value is the address of the next character the parser
+   will read from the memory buffer set by ‘rs_csv_set_buffer’ or
+   ‘rs_csv_map_file’.  If the parser does not parse a memory buffer,
+   value is a null pointer.  */
+extern char const *rs_csv_buffer (rs_csv_t *__obj, size_t *__len);
+
 /* Parse the next field in a CSV file.
 
    First argument OBJ is a pointer to a CSV object.
    Second argument STREAM is the stream for reading characters.
+    A null pointer means to parse the memory buffer set by
+    ‘rs_csv_set_buffer’ or ‘rs_csv_map_file’.
+
+   The parser reads characters from STREAM in large blocks and keeps
+   unused characters in an internal buffer for the next call.  Thus,
+   the file position of STREAM is unspecified while parsing a file.
+   Passing another stream discards the buffered characters.
 
    The return value is zero on success, ‘EOF’ signals an end of
    file condition, ‘RS_CSV_SYSTEM_ERROR’ signals a system error,
    and ‘RS_CSV_PARSE_ERROR’ signals a parse error.  */
 extern int rs_csv_parse (rs_csv_t *__obj, FILE *__stream);
 
+/* Parse the next row in a CSV file.
+
+   First argument OBJ is a pointer to a CSV object.
+   Second argument STREAM is the stream for reading characters,
+    see ‘rs_csv_parse’.
+   Third argument FIELD is the address of a pointer variable.  It
+    is set to the address of the array of fields.
+   Fourth argument COUNT is the address of a variable.  It is set
+    to the number of fields.
+
+   The field values of a row are copied into a row buffer.  The
+   ‘off’ member of a field is the offset of the field value relative
+   to the address returned by ‘rs_csv_row_buffer’.  Each field value
+   is null-terminated, including null field values, which are empty.
+   The array of fields and the row buffer are owned by the CSV object
+   and are reused by the next call.
+
+   The return value has the same meaning as the return value of the
+   ‘rs_csv_parse’ function.  If the row is incomplete because of an
+   error, COUNT is the number of fields parsed so far.  At the end of
+   the file, COUNT is zero.  */
+extern int rs_csv_parse_row (rs_csv_t *__obj, FILE *__stream, rs_csv_field_t const **__field, size_t *__count);
+
+/* Return the address of the row buffer of the most recently parsed
+   row, see ‘rs_csv_parse_row’.  */
+extern char const *rs_csv_row_buffer (rs_csv_t *__obj);
+
 /* Query the status of the parser.
 
    Argument OBJ is a pointer to a CSV object.
@@ -177,9 +316,22 @@ extern int rs_csv_valuep (rs_csv_t *__obj);
 
 /* Return the address of a character buffer with the contents
    of the most recently parsed field.  The buffer is always
-   null-terminated.  */
+   null-terminated.
+
+   When parsing a memory buffer, the field value is copied into the
+   character buffer on the first call.  If there is not enough memory
+   for the copy, a null pointer is returned and ‘errno’ is set to
+   ‘ENOMEM’.  */
 extern char *rs_csv_value (rs_csv_t *__obj);
 
+/* Return the address of the characters of the most recently parsed
+   field without copying them.
+
+   When parsing a memory buffer, the return value usually points into
+   the memory buffer.  The characters are not null-terminated.  Use
+   ‘rs_csv_length’ to get the number of characters.  */
+extern char const *rs_csv_view (rs_csv_t *__obj);
+
 /* Return the length of the most recently parsed field.  */
 extern size_t rs_csv_length (rs_csv_t *__obj);
 
@@ -0,0 +1,540 @@
+/* rs-workshop-bench.c --- benchmarks for the thread pool
+
+   Copyright (C) 2016 Ralph Schleicher
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+      * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+
+      * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in
+        the documentation and/or other materials provided with the
+        distribution.
+
+      * Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived
+        from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.  */
+
+/* Usage: rs-workshop-bench [-t THREADS] [-n COUNT] [-r ROUNDS]
+                            [-p PRODUCERS] [BENCHMARK...]
+
+   Run the benchmarks for each number of workers in the comma
+   separated list THREADS.  The default is 1, 2, 4, and so on up
+   to the number of processors.  COUNT is the number of work orders
+   of a round and ROUNDS is the number of rounds of a benchmark.
+   PRODUCERS is the number of client threads placing work orders
+   in the ‘producers’ benchmark.
+
+   The output is a table of comma-separated values, one row for each
+   benchmark and number of workers.  The columns are the name of the
+   benchmark, the number of workers, the total number of work orders,
+   the total time in seconds, the number of work orders per second,
+   and the 50th, 90th, and 99th percentile and the maximum of the
+   round times in microseconds.  */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "rs-workshop.h"
+
+/* Forward declarations.  */
+typedef struct bench bench_t;
+typedef struct producer producer_t;
+
+static double now (void);
+static size_t run_empty (rs_workshop_t *workshop);
+static size_t run_fanout (rs_workshop_t *workshop);
+static size_t run_producers (rs_workshop_t *workshop);
+static size_t run_forkjoin (rs_workshop_t *workshop);
+static size_t run_imbalanced (rs_workshop_t *workshop);
+static void empty (void *arg);
+static void *produce (void *arg);
+static void *fib (void *arg);
+static size_t fib_calls (long n);
+static void triangle (size_t begin, size_t end, void *arg);
+static int compare (void const *left, void const *right);
+static double percentile (double const *sample, size_t n, double p);
+static void usage (void);
+
+/* A benchmark.  */
+struct bench
+  {
+    /* Name of the benchmark.  */
+    char const *name;
+
+    /* Run one round of the benchmark.  Return value is the number
+       of work orders processed in the round.  */
+    size_t (*run) (rs_workshop_t *);
+  };
+
+static bench_t const bench[] =
+  {
+    {"empty", run_empty},
+    {"fanout", run_fanout},
+    {"producers", run_producers},
+    {"forkjoin", run_forkjoin},
+    {"imbalanced", run_imbalanced},
+    {NULL, NULL}
+  };
+
+/* A client thread placing work orders.  */
+struct producer
+  {
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* Number of work orders to place.  */
+    size_t count;
+
+    /* Thread handle.  */
+    pthread_t thread;
+  };
+
+/* Number of work orders of a round.  */
+static size_t count = 100000;
+
+/* Number of rounds of a benchmark.  */
+static int rounds = 10;
+
+/* Number of producer threads.  */
+static int producers = 4;
+
+/* The thread pool of the fork/join benchmark.  */
+static rs_workshop_t *fib_workshop;
+
+/* Number of work orders of a fan-out.  */
+#define FANOUT 64
+
+/* Argument of the root of the fork/join benchmark.  */
+#define FIB 20
+
+/* Program name.  */
+static char const *program;
+
+int
+main (int argc, char *argv[])
+{
+  int threads[64];
+  int thread_count = 0;
+  int enabled[sizeof (bench) / sizeof (bench[0])];
+  int opt, b, j, k, cpus;
+  double *sample;
+
+  program = argv[0];
+
+  while ((opt = getopt (argc, argv, "t:n:r:p:h")) != -1)
+    {
+      switch (opt)
+	{
+	case 't':
+	  {
+	    char *p = optarg;
+
+	    while (*p != 0 && thread_count < 64)
+	      {
+		threads[thread_count] = (int) strtol (p, &p, 10);
+		if (threads[thread_count] < 1)
+		  usage ();
+
+		++thread_count;
+
+		if (*p == ',')
+		  ++p;
+		else if (*p != 0)
+		  usage ();
+	      }
+	  }
+	  break;
+	case 'n':
+	  count = (size_t) strtoul (optarg, NULL, 10);
+	  if (count == 0)
+	    usage ();
+	  break;
+	case 'r':
+	  rounds = atoi (optarg);
+	  if (rounds < 1)
+	    usage ();
+	  break;
+	case 'p':
+	  producers = atoi (optarg);
+	  if (producers < 1)
+	    usage ();
+	  break;
+	default:
+	  usage ();
+	}
+    }
+
+  /* Default thread counts.  */
+  if (thread_count == 0)
+    {
+      cpus = (int) sysconf (_SC_NPROCESSORS_ONLN);
+      if (cpus < 1)
+	cpus = 1;
+
+      for (k = 1; k < cpus && thread_count < 63; k *= 2)
+	threads[thread_count++] = k;
+
+      threads[thread_count++] = cpus;
+    }
+
+  /* Select benchmarks.  */
+  for (b = 0; bench[b].name != NULL; ++b)
+    enabled[b] = (optind == argc);
+
+  for (j = optind; j < argc; ++j)
+    {
+      for (b = 0; bench[b].name != NULL; ++b)
+	{
+	  if (strcmp (argv[j], bench[b].name) == 0)
+	    break;
+	}
+
+      if (bench[b].name == NULL)
+	usage ();
+
+      enabled[b] = 1;
+    }
+
+  sample = calloc (rounds, sizeof (double));
+  if (sample == NULL)
+    {
+      perror (program);
+      return 1;
+    }
+
+  printf ("benchmark,workers,orders,seconds,orders_per_second,p50_us,p90_us,p99_us,max_us\n");
+
+  for (b = 0; bench[b].name != NULL; ++b)
+    {
+      if (! enabled[b])
+	continue;
+
+      for (j = 0; j < thread_count; ++j)
+	{
+	  rs_workshop_t *workshop;
+	  size_t orders = 0;
+	  double total = 0.0;
+
+	  workshop = rs_workshop_open (threads[j]);
+	  if (workshop == NULL)
+	    {
+	      perror (program);
+	      return 1;
+	    }
+
+	  /* Warm up, e.g. fill the envelope store.  */
+	  bench[b].run (workshop);
+
+	  for (k = 0; k < rounds; ++k)
+	    {
+	      double start = now ();
+
+	      orders += bench[b].run (workshop);
+
+	      sample[k] = now () - start;
+	      total += sample[k];
+	    }
+
+	  rs_workshop_close (workshop);
+
+	  qsort (sample, rounds, sizeof (double), compare);
+
+	  printf ("%s,%d,%lu,%.6f,%.0f,%.1f,%.1f,%.1f,%.1f\n",
+		  bench[b].name, threads[j], (unsigned long) orders, total,
+		  total > 0.0 ? (double) orders / total : 0.0,
+		  percentile (sample, rounds, 0.50) * 1.0E6,
+		  percentile (sample, rounds, 0.90) * 1.0E6,
+		  percentile (sample, rounds, 0.99) * 1.0E6,
+		  sample[rounds - 1] * 1.0E6);
+
+	  fflush (stdout);
+	}
+    }
+
+  free (sample);
+
+  return 0;
+}
+
+/* Return the value of a monotonic clock in seconds.  */
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1.0E9;
+}
+
+/* Throughput of empty work orders placed by a single client.  */
+static size_t
+run_empty (rs_workshop_t *workshop)
+{
+  size_t k;
+
+  for (k = 0; k < count; ++k)
+    {
+      if (rs_workshop_order (workshop, empty, NULL) != 0)
+	{
+	  perror (program);
+	  exit (1);
+	}
+    }
+
+  rs_workshop_wait (workshop);
+
+  return count;
+}
+
+/* Latency of a fan-out of empty work orders followed by a fan-in.  */
+static size_t
+run_fanout (rs_workshop_t *workshop)
+{
+  rs_workshop_group_t *group;
+  rs_work_order_t order[FANOUT];
+  size_t k, n;
+
+  group = rs_workshop_group_new (workshop);
+  if (group == NULL)
+    {
+      perror (program);
+      exit (1);
+    }
+
+  for (k = 0; k < FANOUT; ++k)
+    {
+      order[k].fun = empty;
+      order[k].arg = NULL;
+    }
+
+  for (n = 0; n < count; n += FANOUT)
+    {
+      if (rs_workshop_group_order_batch (group, order, FANOUT) != 0)
+	{
+	  perror (program);
+	  exit (1);
+	}
+
+      rs_workshop_group_wait (group);
+    }
+
+  rs_workshop_group_delete (group);
+
+  return n;
+}
+
+/* Throughput of empty work orders placed by multiple clients.  */
+static size_t
+run_producers (rs_workshop_t *workshop)
+{
+  producer_t *p;
+  int k;
+
+  p = calloc (producers, sizeof (producer_t));
+  if (p == NULL)
+    {
+      perror (program);
+      exit (1);
+    }
+
+  for (k = 0; k < producers; ++k)
+    {
+      p[k].workshop = workshop;
+      p[k].count = count / producers;
+
+      if (pthread_create (&p[k].thread, NULL, produce, p + k) != 0)
+	{
+	  perror (program);
+	  exit (1);
+	}
+    }
+
+  for (k = 0; k < producers; ++k)
+    pthread_join (p[k].thread, NULL);
+
+  rs_workshop_wait (workshop);
+
+  free (p);
+
+  return (count / producers) * producers;
+}
+
+/* Nested fork/join parallelism.  */
+static size_t
+run_forkjoin (rs_workshop_t *workshop)
+{
+  fib_workshop = workshop;
+  fib ((void *) (long) FIB);
+
+  return fib_calls (FIB);
+}
+
+/* Parallel loop where the work of an index is proportional to
+   the index.  */
+static size_t
+run_imbalanced (rs_workshop_t *workshop)
+{
+  size_t n = count / 100;
+
+  if (n < 1)
+    n = 1;
+
+  if (rs_workshop_for (workshop, 0, n, 1, triangle, NULL) != 0)
+    {
+      perror (program);
+      exit (1);
+    }
+
+  return n;
+}
+
+/* An empty work order.  */
+static void
+empty (void *arg)
+{
+  (void) arg;
+}
+
+/* Start function for a client thread.  */
+static void *
+produce (void *arg)
+{
+  producer_t *p = arg;
+  size_t k;
+
+  for (k = 0; k < p->count; ++k)
+    {
+      while (rs_workshop_order (p->workshop, empty, NULL) != 0)
+	{
+	  if (errno != EAGAIN)
+	    {
+	      perror (program);
+	      exit (1);
+	    }
+	}
+    }
+
+  return NULL;
+}
+
+/* Compute Fibonacci numbers the naive way.  Every call with an
+   argument greater than one places a work order for one branch
+   and computes the other branch itself.  */
+static void *
+fib (void *arg)
+{
+  rs_workshop_future_t *future;
+  long n = (long) arg, x, y;
+
+  if (n < 2)
+    return (void *) n;
+
+  future = rs_workshop_order_future (fib_workshop, fib, (void *) (n - 1));
+  if (future == NULL)
+    {
+      perror (program);
+      exit (1);
+    }
+
+  y = (long) fib ((void *) (n - 2));
+
+  rs_workshop_future_wait (future);
+  x = (long) rs_workshop_future_result (future);
+  rs_workshop_future_release (future);
+
+  return (void *) (x + y);
+}
+
+/* Return the number of work orders placed by ‘fib’.  */
+static size_t
+fib_calls (long n)
+{
+  if (n < 2)
+    return 0;
+
+  return 1 + fib_calls (n - 1) + fib_calls (n - 2);
+}
+
+/* Burn processor time proportional to the index.  */
+static void
+triangle (size_t begin, size_t end, void *arg)
+{
+  volatile size_t sum = 0;
+  size_t i, j;
+
+  (void) arg;
+
+  for (i = begin; i < end; ++i)
+    {
+      for (j = 0; j < i * 100; ++j)
+	sum += j;
+    }
+}
+
+/* Comparison function for sorting round times.  */
+static int
+compare (void const *left, void const *right)
+{
+  double a = *(double const *) left;
+  double b = *(double const *) right;
+
+  return (a > b) - (a < b);
+}
+
+/* Return the P-th quantile of the sorted array SAMPLE with N
+   elements (nearest rank method).  */
+static double
+percentile (double const *sample, size_t n, double p)
+{
+  size_t k;
+
+  k = (size_t) (p * (double) n + 0.5);
+  if (k > 0)
+    --k;
+
+  if (k >= n)
+    k = n - 1;
+
+  return sample[k];
+}
+
+/* Display a usage message and exit.  */
+static void
+usage (void)
+{
+  fprintf (stderr, "Usage: %s [-t THREADS] [-n COUNT] [-r ROUNDS] [-p PRODUCERS] [BENCHMARK...]\n", program);
+  exit (2);
+}
+
+/*
+ * local variables:
+ * compile-command: "make -r bench-workshop"
+ * end:
+ */
@@ -35,25 +35,251 @@
 #undef NDEBUG
 #endif
 
+/* CPU affinity is only supported on GNU/Linux.  */
+#ifdef __linux__
+#define HAVE_AFFINITY 1
+#else /* not __linux__ */
+#define HAVE_AFFINITY 0
+#endif /* not __linux__ */
+
+#if HAVE_AFFINITY && ! defined (_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#if HAVE_AFFINITY
+#include <stdio.h>
+#endif
+
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 #include "rs-workshop.h"
 
 /* Forward declarations.  */
 typedef struct rs_task rs_task_t;
+typedef struct rs_worker rs_worker_t;
+typedef struct rs_slab rs_slab_t;
+typedef struct rs_loop rs_loop_t;
+typedef struct rs_ring rs_ring_t;
+typedef struct rs_cell rs_cell_t;
 
 static int init (rs_workshop_t *workshop);
 static void destroy (rs_workshop_t *workshop);
-static void *worker_thread (rs_workshop_t *workshop);
-static int push_task (rs_task_t *task, rs_workshop_t *workshop);
-static rs_task_t *pop_task (rs_workshop_t *workshop);
+static int init_worker (rs_worker_t *worker, rs_workshop_t *workshop, int id);
+static void destroy_worker (rs_worker_t *worker);
+static void *worker_thread (rs_worker_t *worker);
+static int hire (rs_workshop_t *workshop);
+static int retiring (rs_workshop_t *workshop);
+static int understaffed (rs_workshop_t *workshop);
+static int bind_workers (rs_workshop_t *workshop, rs_workshop_options_t const *options);
+#if HAVE_AFFINITY
+static int read_cpu_list (char const *file_name, cpu_set_t *set);
+#endif
+static rs_worker_t *current_worker (rs_workshop_t *workshop);
+static int check_orders (rs_work_order_t const *orders, size_t count);
+static int place (rs_workshop_t *workshop, rs_workshop_group_t *group, int level, rs_work_order_t const *orders, size_t count);
+static void run_task (rs_task_t *task, rs_worker_t *worker);
+static void collect (rs_worker_t *worker, rs_workshop_worker_stats_t *stats);
+static void record (atomic_size_t *histogram, unsigned long long duration);
+static unsigned long long now (void);
+static int loop (rs_workshop_t *workshop, rs_loop_t *loop, size_t begin, size_t end);
+static void run_range (rs_loop_t *loop, size_t begin, size_t end, rs_worker_t *worker);
+static int spawn_range (rs_loop_t *loop, size_t begin, size_t end, rs_worker_t *worker);
+static void leave_group (rs_workshop_group_t *group, size_t count);
+static void wait_group (rs_workshop_group_t *group);
+static void join_group (rs_workshop_group_t *group);
+static void help (rs_worker_t *worker, rs_workshop_group_t *group);
+static void ready_node (rs_workshop_node_t *node);
+static void run_future (void *future);
+static int add_timer (rs_workshop_timer_t *timer);
+static void expire_timers (rs_workshop_t *workshop);
+static void done_timers (rs_workshop_t *workshop, rs_workshop_timer_t **timer, size_t n);
+static void sift_up (rs_workshop_t *workshop, size_t k);
+static void sift_down (rs_workshop_t *workshop, size_t k);
+static void remove_timer (rs_workshop_t *workshop, size_t k);
+static unsigned long long seconds_to_ns (double seconds);
+static void run_node (void *node);
+static int helped (rs_workshop_t *workshop, rs_workshop_group_t *group);
+static rs_task_t *alloc_task (rs_workshop_t *workshop, rs_worker_t *worker);
+static void free_task (rs_task_t *task, rs_workshop_t *workshop, rs_worker_t *worker);
+static rs_task_t *grow_store (rs_workshop_t *workshop);
+static int push_task (rs_task_t *task, size_t count, int level, rs_workshop_t *workshop);
+static void enqueue (rs_task_t *task, size_t count, rs_workshop_t *workshop, rs_worker_t *worker);
+static void wake (rs_workshop_t *workshop, size_t count);
+static int reserve (rs_workshop_t *workshop, size_t count);
+static void release (rs_workshop_t *workshop, size_t count);
+static rs_task_t *pop_task (rs_worker_t *worker);
+static rs_task_t *find_task (rs_worker_t *worker);
+static int linger (rs_workshop_t *workshop);
+static int push_local (rs_task_t *task, size_t count, rs_worker_t *worker);
+static rs_task_t *pop_local (rs_worker_t *worker);
+static rs_task_t *steal_local (rs_worker_t *victim);
+static rs_task_t *steal (rs_worker_t *worker);
+static rs_task_t *take_injected (rs_workshop_t *workshop);
+static rs_task_t *take_level (rs_workshop_t *workshop, int level);
+static rs_task_t *unlink_level (rs_workshop_t *workshop, int level);
+static void append_injected (rs_task_t *task, size_t count, int level, rs_workshop_t *workshop);
+static rs_ring_t *make_ring (size_t size);
+static int ring_push (rs_ring_t *ring, rs_task_t *task);
+static rs_task_t *ring_pop (rs_ring_t *ring);
 static void finish (rs_workshop_t *workshop, int shutdown);
 static void shutdown (rs_workshop_t *workshop);
 
+/* Initial number of elements of a work-stealing deque.
+   Must be a power of two.  */
+#define DEQUE_SIZE 64
+
+/* Alignment of the accumulators of a parallel reduction.  Avoids
+   false sharing between workers.  */
+#define CACHE_LINE 64
+
+/* Priority levels.  A level is an index into the injection queues,
+   i.e. the opposite of a priority.  */
+#define LEVELS 3
+#define LEVEL_HIGH 0
+#define LEVEL_NORMAL 1
+#define LEVEL_LOW 2
+
+/* Convert a priority into a level.  */
+#define level_of(priority) (LEVEL_NORMAL - (priority))
+
+/* Number of times high priority work orders are preferred before
+   other work orders are considered first, and the number of times
+   low priority work orders are passed over before they are considered
+   first.  Avoids starvation of lower priority work orders.  */
+#define PRIORITY_LIMIT 16
+
+/* Default number of times an idle worker checks for new work orders
+   before going to sleep if the lock-free injection queue is enabled.  */
+#define SPIN_COUNT 256
+
+/* Maximum number of expired timers placed at once.  */
+#define TIMER_BATCH 16
+
+/* Value of the ‘index’ member of a timer which is not scheduled.  */
+#define NO_INDEX ((size_t) -1)
+
+/* States of a worker thread.  */
+#define VACANT 0
+#define RUNNING 1
+#define RETIRED 2
+
+/* Add N to the statistics counter VAR.  The statistics counters of
+   a worker are only modified by the worker itself.  Thus, there is
+   no need for an atomic read-modify-write operation.  */
+#define bump(var, n) atomic_store_explicit (&(var), atomic_load_explicit (&(var), memory_order_relaxed) + (n), memory_order_relaxed)
+
+/* Pause instruction for spin loops.  */
+#if defined (__GNUC__) && (defined (__i386__) || defined (__x86_64__))
+#define cpu_relax() __builtin_ia32_pause ()
+#else /* not __GNUC__ */
+#if defined (__GNUC__) && defined (__aarch64__)
+#define cpu_relax() __asm__ __volatile__ ("yield" ::: "memory")
+#else /* not __aarch64__ */
+#define cpu_relax() (void) 0
+#endif /* not __aarch64__ */
+#endif /* not __GNUC__ */
+
+/* Number of envelopes allocated at once.  */
+#define SLAB_SIZE 256
+
+/* Maximum number of envelopes in the cache of a worker.  If the
+   cache overflows, half of the envelopes are returned to the shared
+   store.  Likewise, an empty cache is refilled with that many
+   envelopes.  */
+#define CACHE_SIZE 128
+
+/* A worker.  */
+struct rs_worker
+  {
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* Worker index (zero based).  */
+    int id;
+
+    /* Thread handle.  */
+    pthread_t thread;
+
+    /* State of the worker thread.  A vacant worker has no thread or
+       a detached thread which no longer uses the worker object.  A
+       retired worker has a thread which is about to terminate.  Only
+       accessed while holding the pool lock.  */
+    int state;
+
+    /* Initialization level.  */
+    int rollback;
+
+    /* Synchronize access to the local work orders.  */
+    pthread_mutex_t deque_lock[1];
+
+    /* Local work orders, a double-ended queue.  The worker pushes
+       and pops work orders at the bottom end, i.e. the most recent
+       work order is processed first.  Idle co-workers steal work
+       orders from the top end, i.e. the oldest work order is stolen
+       first.  The deque is a circular array of DEQUE_SIZE elements
+       and TOP and BOTTOM are running indices.  */
+    rs_task_t **deque;
+    size_t deque_size;
+    size_t top;
+    size_t bottom;
+
+    /* Number of work orders in the deque.  Read without holding
+       the lock to skip empty deques when stealing.  */
+    atomic_size_t count;
+
+    /* State of the pseudo-random number generator for choosing
+       a victim.  */
+    unsigned int seed;
+
+    /* NUMA node index.  Zero if the workers are not bound to
+       any CPU.  */
+    int node;
+
+#if HAVE_AFFINITY
+    /* Non-zero means to bind the worker thread to the CPUs in the
+       CPU set.  */
+    int pinned;
+    cpu_set_t cpus;
+#endif
+
+    /* Cache of free envelopes, a LIFO queue.  Only accessed by the
+       worker itself.  */
+    rs_task_t *cache;
+
+    /* Number of envelopes in the cache.  */
+    int cached;
+
+    /* Statistics, see ‘rs_workshop_worker_stats’.  Times are in
+       nanoseconds.  Only modified by the worker itself.  */
+    atomic_size_t submitted;
+    atomic_size_t completed;
+    atomic_ullong started;
+    atomic_ullong busy;
+    atomic_size_t wait_histogram[RS_WORKSHOP_HISTOGRAM_SIZE];
+    atomic_size_t run_histogram[RS_WORKSHOP_HISTOGRAM_SIZE];
+
+    /* Nesting level of work orders, i.e. the number of work orders
+       the worker is processing at the same time.  Greater than one
+       if the worker helps while waiting.  */
+    int depth;
+
+    /* User data, see ‘rs_workshop_worker_data’.  Only accessed by
+       the worker itself.  */
+    void *data;
+
+    /* Task group of the work order the worker is processing, or
+       a null pointer.  Only accessed by the worker itself.  */
+    rs_workshop_group_t *group;
+  };
+
 /* Thread pool.  */
 struct rs_workshop
   {
@@ -64,24 +290,161 @@ struct rs_workshop
     pthread_cond_t work_cond[1];
     pthread_cond_t idle_cond[1];
 
+    /* Signaled if the last work order of a task group is done or if
+       the work orders of a cancelled timer are placed.  */
+    pthread_cond_t done_cond[1];
+
+    /* Signaled if there is space in a bounded injection queue.  */
+    pthread_cond_t space_cond[1];
+
     /* Initialization level.  */
     int rollback;
 
     /* List of workers.  */
-    pthread_t *worker;
+    rs_worker_t *worker;
+
+    /* Number of elements in the list of workers, i.e. the maximum
+       number of workers.  */
+    int slots;
+
+    /* Number of running workers.  Only modified while holding the
+       pool lock, but read without it when placing a work order.  */
+    atomic_int workers;
+
+    /* Desired number of running workers.  If there are more running
+       workers, idle workers retire.  See ‘rs_workshop_resize’.  */
+    atomic_int target;
+
+    /* Auto-scaling.  If IDLE_TIMEOUT is greater than zero, workers
+       idle for IDLE_TIMEOUT nanoseconds retire as long as there are
+       more than MIN_WORKERS running workers.  If work orders pile up,
+       further workers are started up to the desired number of running
+       workers.  */
+    int min_workers;
+    unsigned long long idle_timeout;
+
+    /* Number of NUMA nodes the workers are distributed across.
+       Idle workers prefer to steal work orders from co-workers
+       on the same node if this number is greater than one.  */
+    int nodes;
+
+    /* Number of idle workers.  Only modified while holding the
+       pool lock, but read without it when placing a work order.  */
+    atomic_int idle;
+
+    /* Number of queued work orders, i.e. the sum of the work orders
+       in the injection queue and in the local deques of all workers.
+       The counter is incremented before a work order is queued and
+       decremented after it has been removed from a queue.  */
+    atomic_size_t queued;
+
+    /* Number of work orders in the injection queues, one for each
+       priority level.  */
+    atomic_size_t injected[LEVELS];
+
+    /* Injection queues for work orders placed by clients that are
+       not a worker of this workshop, FIFO queues.  There is one queue
+       for each priority level.  Work orders with a high or low
+       priority are always added to the injection queue, even if they
+       are placed by a worker.  Only accessed while holding the pool
+       lock.  */
+    rs_task_t *first[LEVELS];
+    rs_task_t *last[LEVELS];
+
+    /* Number of times high priority work orders are taken in a row
+       and number of times low priority work orders are passed over.  */
+    atomic_uint streak;
+    atomic_uint aging;
+
+    /* Optional lock-free injection queue.  Clients try this queue
+       first and only fall back to the locked queue if it is full.  */
+    rs_ring_t *ring;
+
+    /* Maximum number of work orders in the injection queue.
+       A value of zero means that the queue is unbounded.  */
+    size_t capacity;
+
+    /* Non-zero means that clients wait until there is space in
+       a full injection queue.  Otherwise, work orders are rejected
+       if the injection queue is full.  */
+    int block;
+
+    /* Number of work orders in the injection queue, including the
+       lock-free queue, and the number of places reserved for work
+       orders.  Only maintained if the queue is bounded.  */
+    atomic_size_t backlog;
+
+    /* Number of clients waiting for space in the injection queue.
+       Only modified while holding the pool lock.  */
+    atomic_int blocked;
+
+    /* Non-zero means to measure the time of work orders.  */
+    int timing;
+
+    /* Initialization and termination of the worker data.  */
+    void *(*worker_init) (int, void *);
+    void (*worker_exit) (int, void *, void *);
+    void *worker_arg;
+
+    /* Number of work orders placed by clients that are not a worker
+       of the thread pool.  */
+    atomic_size_t submitted;
+
+    /* Number of work orders processed by the client because there
+       are no workers.  */
+    atomic_size_t completed;
+
+    /* Maximum number of queued work orders.  */
+    atomic_size_t peak;
+
+    /* Idle policy.  An idle worker checks for new work orders SPIN
+       times with a pause instruction in between, then YIELD times
+       with yielding the processor in between, and then goes to
+       sleep.  */
+    int spin;
+    int yield;
 
-    /* Total number of workers.  */
-    int workers;
+    /* Synchronize access to the envelope store.  */
+    pthread_mutex_t store_lock[1];
 
-    /* Number of idle workers.  */
-    int idle;
+    /* Free envelopes, a LIFO queue.  */
+    rs_task_t *store;
 
-    /* List of work orders, a FIFO queue.  */
-    rs_task_t *first;
-    rs_task_t *last;
+    /* List of allocated slabs.  */
+    rs_slab_t *slab;
 
-    /* Non-zero means that ‘rs_workshop_wait’ is executing.  */
-    unsigned int waiting:1;
+    /* Number of allocated slabs, i.e. the number of times the
+       envelope store had to grow.  */
+    size_t slabs;
+
+    /* Free futures, a LIFO queue.  Only accessed while holding
+       the store lock.  */
+    rs_workshop_future_t *future;
+
+    /* Pending timers, a binary heap ordered by the due time.  Only
+       accessed while holding the pool lock.  */
+    rs_workshop_timer_t **heap;
+    size_t heap_size;
+
+    /* Number of pending timers and the due time of the next timer in
+       nanoseconds.  Only modified while holding the pool lock, but
+       read without it to check for expired timers.  */
+    atomic_size_t timers;
+    atomic_ullong next_due;
+
+    /* Non-zero means that an idle worker waits for the next timer.
+       Only accessed while holding the pool lock.  */
+    unsigned int timekeeper:1;
+
+    /* Number of workers waiting for other work orders while
+       processing a work order.  Only modified while holding the pool
+       lock, but read without it when placing a work order.  */
+    atomic_int helpers;
+
+    /* Number of threads executing ‘rs_workshop_wait’.  Non-zero
+       means that the injection queue is closed.  Only modified while
+       holding the pool lock.  */
+    atomic_int waiting;
 
     /* Non-zero means that ‘rs_workshop_close’ is executing,
        that means the pool is going to be destroyed.  */
@@ -99,20 +462,300 @@ struct rs_task
 
     /* Function argument.  */
     void *arg;
+
+    /* The task group, or a null pointer.  */
+    rs_workshop_group_t *group;
+
+    /* The parallel loop, or a null pointer.  In the later case, the
+       work order processes the indices BEGIN to END of the loop.  */
+    rs_loop_t *loop;
+    size_t begin;
+    size_t end;
+
+    /* Non-zero means that the work order occupies a place in a
+       bounded injection queue.  */
+    unsigned int reserved:1;
+
+    /* Time when the work order has been queued in nanoseconds.
+       Only set if the time of work orders is measured.  */
+    unsigned long long stamp;
+  };
+
+/* Task group.  */
+struct rs_workshop_group
+  {
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* Number of pending work orders.  */
+    atomic_size_t pending;
+
+    /* Number of threads waiting for the group.  Only modified while
+       holding the pool lock.  */
+    atomic_int waiters;
+
+    /* Priority level of the work orders.  */
+    int level;
+
+    /* Non-zero means that the work orders are cancelled.  */
+    atomic_int cancelled;
+  };
+
+/* Task graph.  */
+struct rs_workshop_graph
+  {
+    /* The task group of the graph.  Nodes become members of the
+       task group when they are ready to run.  */
+    rs_workshop_group_t group[1];
+
+    /* Synchronize access to the successors of the nodes.  */
+    pthread_mutex_t lock[1];
+
+    /* List of all nodes.  */
+    rs_workshop_node_t *node;
+  };
+
+/* Timer.  */
+struct rs_workshop_timer
+  {
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* Due time and period in nanoseconds.  A period of zero means
+       that the timer expires only once.  */
+    unsigned long long due;
+    unsigned long long period;
+
+    /* The call-back function.  */
+    void (*fun) (void *);
+
+    /* Function argument.  */
+    void *arg;
+
+    /* Position in the heap of pending timers.  */
+    size_t index;
+
+    /* Number of work orders of the timer which expired but are not
+       yet placed.  Only accessed while holding the pool lock.  */
+    int flight;
+  };
+
+/* Future.  */
+struct rs_workshop_future
+  {
+    /* The task group of the future.  The work order is the only
+       member of the task group.  */
+    rs_workshop_group_t group[1];
+
+    /* A linked list of free futures.  */
+    rs_workshop_future_t *link;
+
+    /* The call-back function.  */
+    void *(*fun) (void *);
+
+    /* Function argument.  */
+    void *arg;
+
+    /* Return value of the call-back function.  */
+    void *result;
+  };
+
+/* Node of a task graph.  */
+struct rs_workshop_node
+  {
+    /* The task graph.  */
+    rs_workshop_graph_t *graph;
+
+    /* A linked list.  */
+    rs_workshop_node_t *link;
+
+    /* The call-back function.  */
+    void (*fun) (void *);
+
+    /* Function argument.  */
+    void *arg;
+
+    /* Number of unfinished predecessors.  Plus one while the node
+       is added to the graph.  The node is ready to run when this
+       number drops to zero.  */
+    atomic_size_t deps;
+
+    /* Successors of the node.  Only accessed while holding the lock
+       of the graph until the node is done.  */
+    rs_workshop_node_t **succ;
+    size_t succ_count;
+    size_t succ_size;
+
+    /* Non-zero means that the call-back function has returned.
+       Only accessed while holding the lock of the graph.  */
+    unsigned int done:1;
+  };
+
+/* Parallel loop.  */
+struct rs_loop
+  {
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* Tracks the pending sub-ranges.  */
+    rs_workshop_group_t group[1];
+
+    /* Number of indices processed in one step.  */
+    size_t grain;
+
+    /* The call-back functions.  Either FUN or REDUCE is non-null.  */
+    void (*fun) (size_t, size_t, void *);
+    void (*reduce) (size_t, size_t, void *, void *);
+
+    /* Function argument.  */
+    void *arg;
+
+    /* Accumulators of a parallel reduction, one for each worker plus
+       one for the client.  The accumulators are STRIDE bytes apart.
+       MEM is the allocated memory block.  */
+    char *acc;
+    size_t stride;
+    char *mem;
+
+    /* Non-zero means that an accumulator has been used.  */
+    char *used;
+  };
+
+/* Element of a lock-free queue.  */
+struct rs_cell
+  {
+    /* Sequence number.  The cell is ready for the producer at running
+       index I if the sequence number is equal to I and ready for the
+       consumer if the sequence number is equal to I plus one.  */
+    atomic_size_t seq;
+
+    /* The work order.  */
+    rs_task_t *task;
+  };
+
+/* Bounded lock-free multi-producer multi-consumer queue.  This is
+   Dmitry Vyukov's algorithm, a circular array of cells with sequence
+   numbers.  Producers and consumers claim a cell by incrementing
+   the running index with a compare-and-swap operation.  */
+struct rs_ring
+  {
+    /* Running index of the producers.  */
+    atomic_size_t tail;
+    char tail_pad[CACHE_LINE];
+
+    /* Running index of the consumers.  */
+    atomic_size_t head;
+    char head_pad[CACHE_LINE];
+
+    /* Number of cells minus one.  The number of cells is a power
+       of two.  */
+    size_t mask;
+
+    /* The cells.  */
+    rs_cell_t *cell;
+  };
+
+/* A block of envelopes.  Envelopes are allocated in slabs and
+   recycled through the envelope store and the caches of the workers.
+   Slabs are only freed when the workshop is closed.  */
+struct rs_slab
+  {
+    /* A linked list.  */
+    rs_slab_t *link;
+
+    /* The envelopes.  */
+    rs_task_t task[SLAB_SIZE];
   };
 
+/* Thread-specific data key for the calling worker.  */
+static pthread_key_t worker_key;
+static pthread_once_t worker_key_once = PTHREAD_ONCE_INIT;
+static int worker_key_error;
+
+/* Create the thread-specific data key.  */
+static void
+create_worker_key (void)
+{
+  worker_key_error = pthread_key_create (&worker_key, NULL);
+}
+
 /* Open a workshop.  */
 rs_workshop_t *
 rs_workshop_open (int workers)
+{
+  rs_workshop_options_t options[1];
+
+  rs_workshop_options_init (options);
+  options->workers = workers;
+
+  return rs_workshop_open_ext (options);
+}
+
+/* Initialize workshop options.  */
+void
+rs_workshop_options_init (rs_workshop_options_t *options)
+{
+  memset (options, 0, sizeof (rs_workshop_options_t));
+
+  options->workers = 0;
+  options->ring_size = 0;
+  options->spin = -1;
+  options->yield = 0;
+  options->cpus = NULL;
+  options->cpu_count = 0;
+  options->numa = 0;
+  options->capacity = 0;
+  options->block = 0;
+  options->timing = 0;
+  options->min_workers = 1;
+  options->idle_timeout = 0.0;
+  options->max_workers = 0;
+  options->worker_init = NULL;
+  options->worker_exit = NULL;
+  options->worker_arg = NULL;
+}
+
+/* Open a workshop with options.  */
+rs_workshop_t *
+rs_workshop_open_ext (rs_workshop_options_t const *options)
 {
   rs_workshop_t *workshop;
+  int workers;
 
-  if (workers < 0)
+  if (options == NULL || options->workers < 0 || options->yield < 0
+      || options->max_workers < 0
+      || (options->cpus != NULL && options->cpu_count == 0)
+      || ! (options->idle_timeout >= 0.0)
+      || (options->idle_timeout > 0.0 && options->workers > 0
+	  && (options->min_workers < 1 || options->min_workers > options->workers)))
     {
       errno = EINVAL;
       return NULL;
     }
 
+  if (options->cpus != NULL)
+    {
+      size_t j;
+
+      for (j = 0; j < options->cpu_count; ++j)
+	{
+	  if (options->cpus[j] < 0)
+	    {
+	      errno = EINVAL;
+	      return NULL;
+	    }
+	}
+    }
+
+  workers = options->workers;
+
+  if (pthread_once (&worker_key_once, create_worker_key) != 0
+      || worker_key_error != 0)
+    {
+      errno = EAGAIN;
+      return NULL;
+    }
+
   workshop = calloc (1, sizeof (rs_workshop_t));
   if (workshop == NULL)
     return NULL;
@@ -120,30 +763,93 @@ rs_workshop_open (int workers)
   if (init (workshop) != 0)
     goto failure;
 
+  if (workers > 0 && options->ring_size > 0)
+    {
+      workshop->ring = make_ring (options->ring_size);
+      if (workshop->ring == NULL)
+	goto failure;
+    }
+
+  /* Idle policy.  */
+  if (options->spin >= 0)
+    workshop->spin = options->spin;
+  else if (workshop->ring != NULL)
+    workshop->spin = SPIN_COUNT;
+
+  workshop->yield = options->yield;
+
+  workshop->timing = options->timing;
+
+  /* Per-worker data.  */
+  workshop->worker_init = options->worker_init;
+  workshop->worker_exit = options->worker_exit;
+  workshop->worker_arg = options->worker_arg;
+
+  /* Bounded injection queue.  */
+  workshop->capacity = options->capacity;
+  workshop->block = options->block;
+
   if (workers > 0)
     {
-      int k;
+      int k, n, slots;
+
+      /* Reserve places for growing the workshop, see
+	 ‘rs_workshop_resize’.  */
+      slots = (options->max_workers > workers ? options->max_workers : workers);
 
-      workshop->worker = calloc (workers, sizeof (pthread_t));
+      workshop->worker = calloc (slots, sizeof (rs_worker_t));
       if (workshop->worker == NULL)
 	goto failure;
 
+      /* All deques have to be initialized before the first worker
+	 starts stealing.  */
+      for (k = 0; k < slots; ++k)
+	{
+	  /* Increase number of slots.  */
+	  ++workshop->slots;
+
+	  if (init_worker (workshop->worker + k, workshop, k) != 0)
+	    goto failure;
+	}
+
+      /* Assign CPUs to the workers.  */
+      if (bind_workers (workshop, options) != 0)
+	goto failure;
+
+      /* Auto-scaling.  */
+      n = workers;
+      if (options->idle_timeout > 0.0)
+	{
+	  workshop->min_workers = options->min_workers;
+	  workshop->idle_timeout = seconds_to_ns (options->idle_timeout);
+	  if (workshop->idle_timeout == 0)
+	    workshop->idle_timeout = 1;
+
+	  /* Further workers are started on demand.  */
+	  n = workshop->min_workers;
+	}
+
+      atomic_store (&workshop->target, workers);
+
       /* Create the worker threads.  */
-      for (k = 0; k < workers; ++k)
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+      for (k = 0; k < n; ++k)
 	{
-	  if (pthread_create (workshop->worker + k, NULL, (void *) worker_thread, workshop) != 0)
+	  if (hire (workshop) != 0)
 	    {
 	      /* If we have already created one or more threads,
 		 continue with that many threads.  */
 	      if (k > 0 && errno == EAGAIN)
 		break;
 
+	      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
 	      goto failure;
 	    }
-
-	  /* Increase number of workers.  */
-	  ++workshop->workers;
 	}
+
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
     }
 
   return workshop;
@@ -160,7 +866,7 @@ rs_workshop_open (int workers)
 int
 rs_workshop_order (rs_workshop_t *workshop, void (*fun) (void *), void *arg)
 {
-  rs_task_t *task;
+  rs_work_order_t order[1];
 
   if (workshop == NULL || fun == NULL)
     {
@@ -168,220 +874,3209 @@ rs_workshop_order (rs_workshop_t *workshop, void (*fun) (void *), void *arg)
       return -1;
     }
 
-  if (workshop->workers == 0)
-    {
-      fun (arg);
-      return 0;
-    }
+  order->fun = fun;
+  order->arg = arg;
 
-  /* Put work order in an envelope.  */
-  task = calloc (1, sizeof (rs_task_t));
-  if (task == NULL)
-    return -1;
+  return place (workshop, NULL, LEVEL_NORMAL, order, 1);
+}
 
-  task->fun = fun;
-  task->arg = arg;
+/* Place a work order with a priority.  */
+int
+rs_workshop_order_priority (rs_workshop_t *workshop, int priority, void (*fun) (void *), void *arg)
+{
+  rs_work_order_t order[1];
 
-  if (push_task (task, workshop) != 0)
+  if (workshop == NULL || fun == NULL
+      || priority < RS_WORKSHOP_PRIORITY_LOW
+      || priority > RS_WORKSHOP_PRIORITY_HIGH)
     {
-      free (task);
+      errno = EINVAL;
       return -1;
     }
 
-  return 0;
+  order->fun = fun;
+  order->arg = arg;
+
+  return place (workshop, NULL, level_of (priority), order, 1);
 }
 
-/* Wait until all work orders are processed.  */
+/* Place multiple work orders at once.  */
 int
-rs_workshop_wait (rs_workshop_t *workshop)
+rs_workshop_order_batch (rs_workshop_t *workshop, rs_work_order_t const *orders, size_t count)
 {
-  if (workshop == NULL)
+  if (workshop == NULL || check_orders (orders, count) != 0)
     {
       errno = EINVAL;
       return -1;
     }
 
-  if (workshop->workers > 0)
-    finish (workshop, 0);
-
-  return 0;
+  return place (workshop, NULL, LEVEL_NORMAL, orders, count);
 }
 
-/* Close a workshop.  */
-int
-rs_workshop_close (rs_workshop_t *workshop)
+/* Create a task group.  */
+rs_workshop_group_t *
+rs_workshop_group_new (rs_workshop_t *workshop)
 {
-  if (workshop != NULL)
+  rs_workshop_group_t *group;
+
+  if (workshop == NULL)
     {
-      destroy (workshop);
-      free (workshop);
+      errno = EINVAL;
+      return NULL;
     }
 
-  return 0;
-}
-
-/* Initialize a thread pool object.  */
-static int
-init (rs_workshop_t *workshop)
-{
-  /* Static initialization.  */
-  workshop->rollback = 0;
-  workshop->worker = NULL;
-  workshop->workers = 0;
-  workshop->idle = 0;
-  workshop->first = NULL;
-  workshop->last = NULL;
-  workshop->waiting = 0;
-  workshop->closing = 0;
+  group = calloc (1, sizeof (rs_workshop_group_t));
+  if (group == NULL)
+    return NULL;
 
-  /* Dynamic initialization.  */
-  if (pthread_mutex_init (workshop->pool_lock, NULL) != 0)
-    return -1;
+  group->workshop = workshop;
+  atomic_init (&group->pending, 0);
+  atomic_init (&group->waiters, 0);
+  group->level = LEVEL_NORMAL;
+  atomic_init (&group->cancelled, 0);
 
-  ++workshop->rollback; /* 1 */
+  return group;
+}
 
-  if (pthread_cond_init (workshop->work_cond, NULL) != 0)
-    return -1;
+/* Destroy a task group.  */
+int
+rs_workshop_group_delete (rs_workshop_group_t *group)
+{
+  if (group != NULL)
+    {
+      rs_workshop_t *workshop = group->workshop;
 
-  ++workshop->rollback; /* 2 */
+      join_group (group);
 
-  if (pthread_cond_init (workshop->idle_cond, NULL) != 0)
-    return -1;
+      /* The worker finishing the last work order of the group may
+	 still hold the pool lock.  */
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
 
-  ++workshop->rollback; /* 3 */
+      free (group);
+    }
+
+  return 0;
+}
+
+/* Set the priority of the work orders of a task group.  */
+int
+rs_workshop_group_set_priority (rs_workshop_group_t *group, int priority)
+{
+  if (group == NULL
+      || priority < RS_WORKSHOP_PRIORITY_LOW
+      || priority > RS_WORKSHOP_PRIORITY_HIGH)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  group->level = level_of (priority);
+
+  return 0;
+}
+
+/* Place a work order as a member of a task group.  */
+int
+rs_workshop_group_order (rs_workshop_group_t *group, void (*fun) (void *), void *arg)
+{
+  rs_work_order_t order[1];
+
+  if (group == NULL || fun == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  order->fun = fun;
+  order->arg = arg;
+
+  return place (group->workshop, group, group->level, order, 1);
+}
+
+/* Place multiple work orders as members of a task group.  */
+int
+rs_workshop_group_order_batch (rs_workshop_group_t *group, rs_work_order_t const *orders, size_t count)
+{
+  if (group == NULL || check_orders (orders, count) != 0)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return place (group->workshop, group, group->level, orders, count);
+}
+
+/* Wait until all work orders of a task group are processed.  */
+int
+rs_workshop_group_wait (rs_workshop_group_t *group)
+{
+  if (group == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  join_group (group);
+
+  return 0;
+}
+
+/* Cancel the work orders of a task group.  */
+int
+rs_workshop_group_cancel (rs_workshop_group_t *group)
+{
+  if (group == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  atomic_store (&group->cancelled, 1);
+
+  return 0;
+}
+
+/* Return non-zero if a task group is cancelled.  */
+int
+rs_workshop_group_cancelled (rs_workshop_group_t *group)
+{
+  if (group == NULL)
+    return 0;
+
+  return atomic_load (&group->cancelled);
+}
+
+/* Return non-zero if the current work order is cancelled.  */
+int
+rs_workshop_cancelled (rs_workshop_t *workshop)
+{
+  rs_worker_t *worker;
+
+  if (workshop == NULL)
+    return 0;
+
+  worker = current_worker (workshop);
+  if (worker == NULL || worker->group == NULL)
+    return 0;
+
+  return atomic_load_explicit (&worker->group->cancelled, memory_order_relaxed);
+}
+
+/* Place a work order with a future.  */
+rs_workshop_future_t *
+rs_workshop_order_future (rs_workshop_t *workshop, void *(*fun) (void *), void *arg)
+{
+  rs_workshop_future_t *future;
+  rs_work_order_t order[1];
+
+  if (workshop == NULL || fun == NULL)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  /* Reuse a future.  */
+  assert (pthread_mutex_lock (workshop->store_lock) == 0);
+
+  future = workshop->future;
+  if (future != NULL)
+    workshop->future = future->link;
+
+  assert (pthread_mutex_unlock (workshop->store_lock) == 0);
+
+  if (future == NULL)
+    {
+      future = malloc (sizeof (rs_workshop_future_t));
+      if (future == NULL)
+	return NULL;
+    }
+
+  future->group->workshop = workshop;
+  atomic_init (&future->group->pending, 0);
+  atomic_init (&future->group->waiters, 0);
+  future->group->level = LEVEL_NORMAL;
+  atomic_init (&future->group->cancelled, 0);
+
+  future->link = NULL;
+  future->fun = fun;
+  future->arg = arg;
+  future->result = NULL;
+
+  order->fun = run_future;
+  order->arg = future;
+
+  if (place (workshop, future->group, LEVEL_NORMAL, order, 1) != 0)
+    {
+      assert (pthread_mutex_lock (workshop->store_lock) == 0);
+
+      future->link = workshop->future;
+      workshop->future = future;
+
+      assert (pthread_mutex_unlock (workshop->store_lock) == 0);
+
+      return NULL;
+    }
+
+  return future;
+}
+
+/* Wait until the work order of a future is processed.  */
+int
+rs_workshop_future_wait (rs_workshop_future_t *future)
+{
+  if (future == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  join_group (future->group);
+
+  return 0;
+}
+
+/* Check if the work order of a future is processed.  */
+int
+rs_workshop_future_try_wait (rs_workshop_future_t *future)
+{
+  if (future == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (atomic_load (&future->group->pending) != 0)
+    {
+      errno = EAGAIN;
+      return -1;
+    }
+
+  return 0;
+}
+
+/* Return the result of a future.  */
+void *
+rs_workshop_future_result (rs_workshop_future_t *future)
+{
+  if (future == NULL)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  join_group (future->group);
+
+  return future->result;
+}
+
+/* Cancel the work order of a future.  */
+int
+rs_workshop_future_cancel (rs_workshop_future_t *future)
+{
+  if (future == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  atomic_store (&future->group->cancelled, 1);
+
+  return 0;
+}
+
+/* Release a future.  */
+int
+rs_workshop_future_release (rs_workshop_future_t *future)
+{
+  if (future != NULL)
+    {
+      rs_workshop_t *workshop = future->group->workshop;
+
+      join_group (future->group);
+
+      /* See ‘rs_workshop_group_delete’.  */
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+      assert (pthread_mutex_lock (workshop->store_lock) == 0);
+
+      future->link = workshop->future;
+      workshop->future = future;
+
+      assert (pthread_mutex_unlock (workshop->store_lock) == 0);
+    }
+
+  return 0;
+}
+
+/* Place a work order at a certain time.  */
+int
+rs_workshop_order_at (rs_workshop_t *workshop, struct timespec const *abstime, void (*fun) (void *), void *arg)
+{
+  struct timespec ts;
+  double delay;
+
+  if (workshop == NULL || abstime == NULL || fun == NULL
+      || abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000L)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  /* Convert the absolute time into a delay.  */
+  assert (clock_gettime (CLOCK_REALTIME, &ts) == 0);
+
+  delay = (double) (abstime->tv_sec - ts.tv_sec) + (double) (abstime->tv_nsec - ts.tv_nsec) / 1.0E9;
+
+  return rs_workshop_order_after (workshop, delay, fun, arg);
+}
+
+/* Place a work order after a delay.  */
+int
+rs_workshop_order_after (rs_workshop_t *workshop, double seconds, void (*fun) (void *), void *arg)
+{
+  rs_workshop_timer_t *timer;
+
+  if (workshop == NULL || fun == NULL || seconds != seconds)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  timer = malloc (sizeof (rs_workshop_timer_t));
+  if (timer == NULL)
+    return -1;
+
+  timer->workshop = workshop;
+  timer->due = now () + seconds_to_ns (seconds);
+  timer->period = 0;
+  timer->fun = fun;
+  timer->arg = arg;
+  timer->index = NO_INDEX;
+  timer->flight = 0;
+
+  if (add_timer (timer) != 0)
+    {
+      free (timer);
+      return -1;
+    }
+
+  return 0;
+}
+
+/* Place a work order periodically.  */
+rs_workshop_timer_t *
+rs_workshop_order_every (rs_workshop_t *workshop, double interval, void (*fun) (void *), void *arg)
+{
+  rs_workshop_timer_t *timer;
+
+  if (workshop == NULL || fun == NULL || ! (interval > 0.0))
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  timer = malloc (sizeof (rs_workshop_timer_t));
+  if (timer == NULL)
+    return NULL;
+
+  timer->workshop = workshop;
+  timer->period = seconds_to_ns (interval);
+  if (timer->period == 0)
+    timer->period = 1;
+  timer->due = now () + timer->period;
+  timer->fun = fun;
+  timer->arg = arg;
+  timer->index = NO_INDEX;
+  timer->flight = 0;
+
+  if (add_timer (timer) != 0)
+    {
+      free (timer);
+      return NULL;
+    }
+
+  return timer;
+}
+
+/* Cancel a periodic work order.  */
+int
+rs_workshop_timer_cancel (rs_workshop_timer_t *timer)
+{
+  if (timer != NULL)
+    {
+      rs_workshop_t *workshop = timer->workshop;
+
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+      if (timer->index != NO_INDEX)
+	remove_timer (workshop, timer->index);
+
+      /* Wait until an expired work order of the timer is placed.
+	 Otherwise, the work order could be placed after this function
+	 returns.  */
+      while (timer->flight > 0)
+	assert (pthread_cond_wait (workshop->done_cond, workshop->pool_lock) == 0);
+
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+      free (timer);
+    }
+
+  return 0;
+}
+
+/* Create a task graph.  */
+rs_workshop_graph_t *
+rs_workshop_graph_new (rs_workshop_t *workshop)
+{
+  rs_workshop_graph_t *graph;
+
+  if (workshop == NULL)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  graph = calloc (1, sizeof (rs_workshop_graph_t));
+  if (graph == NULL)
+    return NULL;
+
+  graph->group->workshop = workshop;
+  atomic_init (&graph->group->pending, 0);
+  atomic_init (&graph->group->waiters, 0);
+  graph->group->level = LEVEL_NORMAL;
+  atomic_init (&graph->group->cancelled, 0);
+
+  if (pthread_mutex_init (graph->lock, NULL) != 0)
+    {
+      free (graph);
+      return NULL;
+    }
+
+  graph->node = NULL;
+
+  return graph;
+}
+
+/* Destroy a task graph.  */
+int
+rs_workshop_graph_delete (rs_workshop_graph_t *graph)
+{
+  if (graph != NULL)
+    {
+      rs_workshop_t *workshop = graph->group->workshop;
+
+      join_group (graph->group);
+
+      /* See ‘rs_workshop_group_delete’.  */
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+      while (graph->node != NULL)
+	{
+	  rs_workshop_node_t *node = graph->node;
+
+	  graph->node = node->link;
+
+	  if (node->succ != NULL)
+	    free (node->succ);
+
+	  free (node);
+	}
+
+      assert (pthread_mutex_destroy (graph->lock) == 0);
+
+      free (graph);
+    }
+
+  return 0;
+}
+
+/* Add a node to a task graph.  */
+rs_workshop_node_t *
+rs_workshop_graph_node (rs_workshop_graph_t *graph, void (*fun) (void *), void *arg, rs_workshop_node_t *const *preds, size_t count)
+{
+  rs_workshop_node_t *node, *pred;
+  size_t k;
+
+  if (graph == NULL || fun == NULL || (preds == NULL && count > 0))
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  for (k = 0; k < count; ++k)
+    {
+      if (preds[k] == NULL || preds[k]->graph != graph)
+	{
+	  errno = EINVAL;
+	  return NULL;
+	}
+    }
+
+  node = calloc (1, sizeof (rs_workshop_node_t));
+  if (node == NULL)
+    return NULL;
+
+  node->graph = graph;
+  node->fun = fun;
+  node->arg = arg;
+
+  /* The node must not run before all predecessors are known.  */
+  atomic_init (&node->deps, 1);
+
+  assert (pthread_mutex_lock (graph->lock) == 0);
+
+  /* Make room for the new successor first.  Thus, the graph does
+     not change if there is not enough memory.  */
+  for (k = 0; k < count; ++k)
+    {
+      pred = preds[k];
+      if (pred->done || pred->succ_count + count <= pred->succ_size)
+	continue;
+
+      {
+	rs_workshop_node_t **succ;
+	size_t size;
+
+	size = 2 * pred->succ_size;
+	if (size < pred->succ_count + count)
+	  size = pred->succ_count + count;
+	if (size < 4)
+	  size = 4;
+
+	succ = realloc (pred->succ, size * sizeof (rs_workshop_node_t *));
+	if (succ == NULL)
+	  {
+	    assert (pthread_mutex_unlock (graph->lock) == 0);
+
+	    free (node);
+	    return NULL;
+	  }
+
+	pred->succ = succ;
+	pred->succ_size = size;
+      }
+    }
+
+  /* Link the node to its unfinished predecessors.  */
+  for (k = 0; k < count; ++k)
+    {
+      pred = preds[k];
+      if (pred->done)
+	continue;
+
+      pred->succ[pred->succ_count++] = node;
+
+      atomic_fetch_add (&node->deps, 1);
+    }
+
+  node->link = graph->node;
+  graph->node = node;
+
+  assert (pthread_mutex_unlock (graph->lock) == 0);
+
+  if (atomic_fetch_sub (&node->deps, 1) == 1)
+    ready_node (node);
+
+  return node;
+}
+
+/* Wait until all nodes of a task graph are processed.  */
+int
+rs_workshop_graph_wait (rs_workshop_graph_t *graph)
+{
+  if (graph == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  join_group (graph->group);
+
+  return 0;
+}
+
+/* Process a range of indices in parallel.  */
+int
+rs_workshop_for (rs_workshop_t *workshop, size_t begin, size_t end, size_t grain, void (*fun) (size_t, size_t, void *), void *arg)
+{
+  rs_loop_t lp[1];
+
+  if (workshop == NULL || fun == NULL || begin > end)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (begin == end)
+    return 0;
+
+  if (workshop->workers == 0)
+    {
+      fun (begin, end, arg);
+      return 0;
+    }
+
+  memset (lp, 0, sizeof (rs_loop_t));
+
+  lp->grain = grain;
+  lp->fun = fun;
+  lp->arg = arg;
+
+  return loop (workshop, lp, begin, end);
+}
+
+/* Reduce a range of indices in parallel.  */
+int
+rs_workshop_reduce (rs_workshop_t *workshop, size_t begin, size_t end, size_t grain, void (*fun) (size_t, size_t, void *, void *), void (*combine) (void *, void const *, void *), void *result, size_t size, void *arg)
+{
+  rs_loop_t lp[1];
+  size_t k, n;
+
+  if (workshop == NULL || fun == NULL || combine == NULL || result == NULL || size == 0 || begin > end)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (begin == end)
+    return 0;
+
+  if (workshop->workers == 0)
+    {
+      fun (begin, end, result, arg);
+      return 0;
+    }
+
+  memset (lp, 0, sizeof (rs_loop_t));
+
+  lp->grain = grain;
+  lp->reduce = fun;
+  lp->arg = arg;
+
+  /* One accumulator for each worker plus one for the client.  */
+  n = workshop->slots + 1;
+
+  if (size > (size_t) -1 / n - CACHE_LINE)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+  lp->stride = (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+
+  lp->mem = malloc (n * lp->stride + CACHE_LINE);
+  if (lp->mem == NULL)
+    return -1;
+
+  lp->acc = lp->mem + (CACHE_LINE - (size_t) lp->mem % CACHE_LINE) % CACHE_LINE;
+
+  lp->used = calloc (n, 1);
+  if (lp->used == NULL)
+    {
+      free (lp->mem);
+      return -1;
+    }
+
+  /* Initialize the accumulators with the identity element.  */
+  for (k = 0; k < n; ++k)
+    memcpy (lp->acc + k * lp->stride, result, size);
+
+  loop (workshop, lp, begin, end);
+
+  /* Combine the partial results.  */
+  for (k = 0; k < n; ++k)
+    {
+      if (lp->used[k])
+	combine (result, lp->acc + k * lp->stride, arg);
+    }
+
+  free (lp->used);
+  free (lp->mem);
+
+  return 0;
+}
+
+/* Return the index of the calling worker.  */
+int
+rs_workshop_worker_id (rs_workshop_t *workshop)
+{
+  rs_worker_t *worker;
+
+  if (workshop == NULL)
+    return -1;
+
+  worker = current_worker (workshop);
+  if (worker == NULL)
+    return -1;
+
+  return worker->id;
+}
+
+/* Return the data of the calling worker.  */
+void *
+rs_workshop_worker_data (rs_workshop_t *workshop)
+{
+  rs_worker_t *worker;
+
+  if (workshop == NULL)
+    return NULL;
+
+  worker = current_worker (workshop);
+  if (worker == NULL)
+    return NULL;
+
+  return worker->data;
+}
+
+/* Query statistics.  */
+int
+rs_workshop_stats (rs_workshop_t *workshop, rs_workshop_stats_t *stats)
+{
+  int k;
+
+  if (workshop == NULL || stats == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  memset (stats, 0, sizeof (rs_workshop_stats_t));
+
+  assert (pthread_mutex_lock (workshop->store_lock) == 0);
+
+  stats->envelopes = workshop->slabs * SLAB_SIZE;
+  stats->slabs = workshop->slabs;
+
+  assert (pthread_mutex_unlock (workshop->store_lock) == 0);
+
+  stats->workers = atomic_load (&workshop->workers);
+  stats->queued = atomic_load (&workshop->queued);
+  stats->peak_queued = atomic_load (&workshop->peak);
+
+  stats->total.submitted = atomic_load_explicit (&workshop->submitted, memory_order_relaxed);
+  stats->total.completed = atomic_load_explicit (&workshop->completed, memory_order_relaxed);
+
+  for (k = 0; k < workshop->slots; ++k)
+    collect (workshop->worker + k, &stats->total);
+
+  return 0;
+}
+
+/* Query statistics of a worker.  */
+int
+rs_workshop_worker_stats (rs_workshop_t *workshop, int index, rs_workshop_worker_stats_t *stats)
+{
+  if (workshop == NULL || stats == NULL
+      || index < 0 || index >= workshop->slots)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  memset (stats, 0, sizeof (rs_workshop_worker_stats_t));
+
+  collect (workshop->worker + index, stats);
+
+  return 0;
+}
+
+/* Change the number of workers.  */
+int
+rs_workshop_resize (rs_workshop_t *workshop, int workers)
+{
+  int retval = 0;
+
+  if (workshop == NULL || workers < 1 || workers > workshop->slots)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+  atomic_store (&workshop->target, workers);
+
+  /* Without auto-scaling, start the missing workers right now.  */
+  if (workshop->idle_timeout == 0)
+    {
+      while (atomic_load (&workshop->workers) < workers)
+	{
+	  if (hire (workshop) != 0)
+	    {
+	      /* Wait until a retired worker vacates its place.  */
+	      if (errno == EAGAIN && retiring (workshop))
+		{
+		  assert (pthread_cond_wait (workshop->idle_cond, workshop->pool_lock) == 0);
+		  continue;
+		}
+
+	      retval = -1;
+	      break;
+	    }
+	}
+    }
+
+  /* Surplus workers retire as soon as they are idle.  */
+  if (atomic_load (&workshop->workers) > workers)
+    assert (pthread_cond_broadcast (workshop->work_cond) == 0);
+
+  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+  return retval;
+}
+
+/* Wait until all work orders are processed.  */
+int
+rs_workshop_wait (rs_workshop_t *workshop)
+{
+  rs_worker_t *worker;
+
+  if (workshop == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (workshop->workers > 0)
+    {
+      worker = current_worker (workshop);
+      if (worker != NULL)
+	{
+	  /* Called from within a work order.  */
+	  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+	  atomic_fetch_add (&workshop->waiting, 1);
+	  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+	  help (worker, NULL);
+
+	  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+	  atomic_fetch_sub (&workshop->waiting, 1);
+	  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+	}
+      else
+	finish (workshop, 0);
+    }
+
+  return 0;
+}
+
+/* Close a workshop.  */
+int
+rs_workshop_close (rs_workshop_t *workshop)
+{
+  if (workshop != NULL)
+    {
+      destroy (workshop);
+      free (workshop);
+    }
+
+  return 0;
+}
+
+/* Initialize a thread pool object.  */
+static int
+init (rs_workshop_t *workshop)
+{
+  int k;
+
+  /* Static initialization.  */
+  workshop->rollback = 0;
+  workshop->worker = NULL;
+  workshop->slots = 0;
+  atomic_init (&workshop->workers, 0);
+  atomic_init (&workshop->target, 0);
+  workshop->min_workers = 0;
+  workshop->idle_timeout = 0;
+  workshop->nodes = 0;
+  atomic_init (&workshop->idle, 0);
+  atomic_init (&workshop->queued, 0);
+  for (k = 0; k < LEVELS; ++k)
+    {
+      atomic_init (&workshop->injected[k], 0);
+      workshop->first[k] = NULL;
+      workshop->last[k] = NULL;
+    }
+  atomic_init (&workshop->streak, 0);
+  atomic_init (&workshop->aging, 0);
+  workshop->ring = NULL;
+  workshop->spin = 0;
+  workshop->yield = 0;
+  workshop->timing = 0;
+  workshop->worker_init = NULL;
+  workshop->worker_exit = NULL;
+  workshop->worker_arg = NULL;
+  atomic_init (&workshop->submitted, 0);
+  atomic_init (&workshop->completed, 0);
+  atomic_init (&workshop->peak, 0);
+  workshop->capacity = 0;
+  workshop->block = 0;
+  atomic_init (&workshop->backlog, 0);
+  atomic_init (&workshop->blocked, 0);
+  workshop->store = NULL;
+  workshop->slab = NULL;
+  workshop->slabs = 0;
+  workshop->future = NULL;
+  workshop->heap = NULL;
+  workshop->heap_size = 0;
+  atomic_init (&workshop->timers, 0);
+  atomic_init (&workshop->next_due, ULLONG_MAX);
+  workshop->timekeeper = 0;
+  atomic_init (&workshop->helpers, 0);
+  atomic_init (&workshop->waiting, 0);
+  workshop->closing = 0;
+
+  /* Dynamic initialization.  */
+  if (pthread_mutex_init (workshop->pool_lock, NULL) != 0)
+    return -1;
+
+  ++workshop->rollback; /* 1 */
+
+  /* Idle workers wait for timers on the monotonic clock.  */
+  {
+    pthread_condattr_t attr;
+    int err;
+
+    if (pthread_condattr_init (&attr) != 0)
+      return -1;
+
+    err = pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+    if (err == 0)
+      err = pthread_cond_init (workshop->work_cond, &attr);
+
+    assert (pthread_condattr_destroy (&attr) == 0);
+
+    if (err != 0)
+      return -1;
+  }
+
+  ++workshop->rollback; /* 2 */
+
+  if (pthread_cond_init (workshop->idle_cond, NULL) != 0)
+    return -1;
+
+  ++workshop->rollback; /* 3 */
+
+  if (pthread_mutex_init (workshop->store_lock, NULL) != 0)
+    return -1;
+
+  ++workshop->rollback; /* 4 */
+
+  if (pthread_cond_init (workshop->done_cond, NULL) != 0)
+    return -1;
+
+  ++workshop->rollback; /* 5 */
+
+  if (pthread_cond_init (workshop->space_cond, NULL) != 0)
+    return -1;
+
+  ++workshop->rollback; /* 6 */
 
   return 0;
 }
 
 /* Terminate a thread pool object.  */
 static void
-destroy (rs_workshop_t *workshop)
+destroy (rs_workshop_t *workshop)
+{
+  int k;
+
+  if (workshop->workers > 0)
+    shutdown (workshop);
+
+  if (workshop->worker != NULL)
+    {
+      for (k = 0; k < workshop->slots; ++k)
+	destroy_worker (workshop->worker + k);
+
+      free (workshop->worker);
+    }
+
+  if (workshop->ring != NULL)
+    {
+      free (workshop->ring->cell);
+      free (workshop->ring);
+    }
+
+  while (workshop->slab != NULL)
+    {
+      rs_slab_t *slab = workshop->slab;
+
+      workshop->slab = slab->link;
+      free (slab);
+    }
+
+  while (workshop->future != NULL)
+    {
+      rs_workshop_future_t *future = workshop->future;
+
+      workshop->future = future->link;
+      free (future);
+    }
+
+  /* Discard pending timers.  */
+  if (workshop->heap != NULL)
+    {
+      size_t j, n = atomic_load (&workshop->timers);
+
+      for (j = 0; j < n; ++j)
+	free (workshop->heap[j]);
+
+      free (workshop->heap);
+    }
+
+  if (workshop->rollback >= 6)
+    assert (pthread_cond_destroy (workshop->space_cond) == 0);
+
+  if (workshop->rollback >= 5)
+    assert (pthread_cond_destroy (workshop->done_cond) == 0);
+
+  if (workshop->rollback >= 4)
+    assert (pthread_mutex_destroy (workshop->store_lock) == 0);
+
+  if (workshop->rollback >= 3)
+    assert (pthread_cond_destroy (workshop->idle_cond) == 0);
+
+  if (workshop->rollback >= 2)
+    assert (pthread_cond_destroy (workshop->work_cond) == 0);
+
+  if (workshop->rollback >= 1)
+    assert (pthread_mutex_destroy (workshop->pool_lock) == 0);
+}
+
+/* Initialize a worker.  */
+static int
+init_worker (rs_worker_t *worker, rs_workshop_t *workshop, int id)
+{
+  int k;
+
+  /* Static initialization.  */
+  worker->workshop = workshop;
+  worker->id = id;
+  worker->state = VACANT;
+  worker->rollback = 0;
+  worker->deque = NULL;
+  worker->deque_size = 0;
+  worker->top = 0;
+  worker->bottom = 0;
+  atomic_init (&worker->count, 0);
+  worker->seed = 2463534242U + (unsigned int) id;
+  worker->node = 0;
+#if HAVE_AFFINITY
+  worker->pinned = 0;
+#endif
+  atomic_init (&worker->submitted, 0);
+  atomic_init (&worker->completed, 0);
+  atomic_init (&worker->started, 0);
+  atomic_init (&worker->busy, 0);
+  for (k = 0; k < RS_WORKSHOP_HISTOGRAM_SIZE; ++k)
+    {
+      atomic_init (&worker->wait_histogram[k], 0);
+      atomic_init (&worker->run_histogram[k], 0);
+    }
+  worker->depth = 0;
+  worker->cache = NULL;
+  worker->cached = 0;
+  worker->data = NULL;
+  worker->group = NULL;
+
+  /* Dynamic initialization.  */
+  if (pthread_mutex_init (worker->deque_lock, NULL) != 0)
+    return -1;
+
+  ++worker->rollback; /* 1 */
+
+  return 0;
+}
+
+/* Terminate a worker.  */
+static void
+destroy_worker (rs_worker_t *worker)
+{
+  if (worker->deque != NULL)
+    free (worker->deque);
+
+  if (worker->rollback >= 1)
+    assert (pthread_mutex_destroy (worker->deque_lock) == 0);
+}
+
+/* Start function for a worker.  */
+static void *
+worker_thread (rs_worker_t *worker)
+{
+  rs_workshop_t *workshop = worker->workshop;
+  rs_task_t *task;
+
+  /* Remember the worker object of the calling thread.  */
+  assert (pthread_setspecific (worker_key, worker) == 0);
+
+  if (workshop->timing)
+    atomic_store_explicit (&worker->started, now (), memory_order_relaxed);
+
+#if HAVE_AFFINITY
+  /* Placement is only a hint, thus ignore errors, e.g. if a CPU
+     is not available.  */
+  if (worker->pinned)
+    pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &worker->cpus);
+#endif
+
+  /* Allocate the worker data after binding the thread so that
+     memory is local to the worker.  */
+  if (workshop->worker_init != NULL)
+    worker->data = workshop->worker_init (worker->id, workshop->worker_arg);
+
+  while (1)
+    {
+      task = pop_task (worker);
+      if (task == NULL)
+	break;
+
+      run_task (task, worker);
+    }
+
+  if (workshop->worker_exit != NULL)
+    workshop->worker_exit (worker->id, worker->data, workshop->worker_arg);
+
+  worker->data = NULL;
+
+  /* A retired worker detaches its thread and vacates its place.
+     Thus, nobody has to join the thread while holding the pool lock,
+     see ‘hire’.  If the workshop is closing, ‘shutdown’ joins the
+     thread instead.  */
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+  if (worker->state == RETIRED && ! workshop->closing)
+    {
+      assert (pthread_detach (pthread_self ()) == 0);
+      worker->state = VACANT;
+
+      /* Wake up ‘rs_workshop_resize’ waiting for a vacant place.  */
+      assert (pthread_cond_broadcast (workshop->idle_cond) == 0);
+    }
+
+  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+  return NULL;
+}
+
+/* Start another worker thread.  The caller must hold the pool lock.
+   Return value is zero on success.  Otherwise, set ‘errno’ and
+   return -1.  */
+static int
+hire (rs_workshop_t *workshop)
+{
+  rs_worker_t *worker = NULL;
+  int k, err;
+
+  /* The place of a retired worker is vacated by the worker itself
+     when its thread is about to terminate.  */
+  for (k = 0; k < workshop->slots; ++k)
+    {
+      worker = workshop->worker + k;
+      if (worker->state == VACANT)
+	break;
+    }
+
+  if (k == workshop->slots)
+    {
+      errno = EAGAIN;
+      return -1;
+    }
+
+  err = pthread_create (&worker->thread, NULL, (void *) worker_thread, worker);
+  if (err != 0)
+    {
+      errno = err;
+      return -1;
+    }
+
+  worker->state = RUNNING;
+
+  /* Increase number of workers.  */
+  atomic_fetch_add (&workshop->workers, 1);
+
+  return 0;
+}
+
+/* Return non-zero if a retired worker did not yet vacate its place.
+   The caller must hold the pool lock.  */
+static int
+retiring (rs_workshop_t *workshop)
+{
+  int k;
+
+  for (k = 0; k < workshop->slots; ++k)
+    {
+      if (workshop->worker[k].state == RETIRED)
+	return 1;
+    }
+
+  return 0;
+}
+
+/* Return non-zero if another worker shall be started because
+   all workers are busy and work orders pile up.  Only applies
+   if auto-scaling is enabled.  */
+static int
+understaffed (rs_workshop_t *workshop)
+{
+  int workers;
+
+  if (workshop->idle_timeout == 0)
+    return 0;
+
+  workers = atomic_load (&workshop->workers);
+
+  return (workers < atomic_load (&workshop->target)
+	  && atomic_load (&workshop->idle) == 0
+	  && atomic_load (&workshop->queued) > (size_t) workers);
+}
+
+/* Assign CPUs to the workers of WORKSHOP.  Return value is zero
+   on success.  Otherwise, set ‘errno’ and return -1.  */
+static int
+bind_workers (rs_workshop_t *workshop, rs_workshop_options_t const *options)
+{
+#if HAVE_AFFINITY
+  cpu_set_t allowed[1], online[1];
+  cpu_set_t *node = NULL;
+  int nodes = 0;
+  int j, k;
+
+  if (options->cpus == NULL && options->numa == 0)
+    return 0;
+
+  if (options->cpus != NULL)
+    {
+      size_t i;
+
+      for (i = 0; i < options->cpu_count; ++i)
+	{
+	  if (options->cpus[i] >= CPU_SETSIZE)
+	    {
+	      errno = EINVAL;
+	      return -1;
+	    }
+	}
+    }
+
+  /* Placement is only a hint, thus run the workers unpinned if the
+     CPUs available to the process are unknown.  */
+  if (sched_getaffinity (0, sizeof (cpu_set_t), allowed) != 0)
+    return 0;
+
+  /* Read the NUMA topology.  Node numbers are treated like CPU
+     numbers.  */
+  if (read_cpu_list ("/sys/devices/system/node/online", online) == 0
+      && CPU_COUNT (online) > 0)
+    {
+      node = calloc (CPU_COUNT (online), sizeof (cpu_set_t));
+      if (node == NULL)
+	return -1;
+
+      for (j = 0; j < CPU_SETSIZE; ++j)
+	{
+	  char file_name[64];
+
+	  if (! CPU_ISSET (j, online))
+	    continue;
+
+	  sprintf (file_name, "/sys/devices/system/node/node%d/cpulist", j);
+	  if (read_cpu_list (file_name, node + nodes) != 0)
+	    continue;
+
+	  /* Skip nodes without available CPUs, e.g. memory
+	     only nodes.  */
+	  CPU_AND (node + nodes, node + nodes, allowed);
+	  if (CPU_COUNT (node + nodes) == 0)
+	    continue;
+
+	  ++nodes;
+	}
+    }
+
+  /* Without NUMA topology, all CPUs belong to a single node.  */
+  if (nodes == 0)
+    {
+      if (node == NULL)
+	{
+	  node = calloc (1, sizeof (cpu_set_t));
+	  if (node == NULL)
+	    return -1;
+	}
+
+      memcpy (node, allowed, sizeof (cpu_set_t));
+      nodes = 1;
+    }
+
+  for (k = 0; k < workshop->slots; ++k)
+    {
+      rs_worker_t *worker = workshop->worker + k;
+
+      if (options->cpus != NULL)
+	{
+	  int cpu = options->cpus[(size_t) k % options->cpu_count];
+
+	  CPU_ZERO (&worker->cpus);
+	  CPU_SET (cpu, &worker->cpus);
+
+	  for (j = 0; j < nodes; ++j)
+	    {
+	      if (CPU_ISSET (cpu, node + j))
+		{
+		  worker->node = j;
+		  break;
+		}
+	    }
+	}
+      else
+	{
+	  /* Distribute the workers round-robin across the nodes.  */
+	  worker->node = k % nodes;
+
+	  memcpy (&worker->cpus, node + worker->node, sizeof (cpu_set_t));
+	}
+
+      worker->pinned = 1;
+    }
+
+  workshop->nodes = nodes;
+
+  free (node);
+#else /* not HAVE_AFFINITY */
+  (void) workshop;
+  (void) options;
+#endif /* not HAVE_AFFINITY */
+
+  return 0;
+}
+
+#if HAVE_AFFINITY
+/* Read a list of CPU numbers, e.g. ‘0-3,8-11’, from the file
+   FILE_NAME into SET.  Return value is zero on success.  Otherwise,
+   set ‘errno’ and return -1.  */
+static int
+read_cpu_list (char const *file_name, cpu_set_t *set)
+{
+  FILE *stream;
+  int low, high, c;
+
+  CPU_ZERO (set);
+
+  stream = fopen (file_name, "r");
+  if (stream == NULL)
+    return -1;
+
+  while (fscanf (stream, "%d", &low) == 1)
+    {
+      high = low;
+
+      c = getc (stream);
+      if (c == '-')
+	{
+	  if (fscanf (stream, "%d", &high) != 1)
+	    break;
+
+	  c = getc (stream);
+	}
+
+      for (; low <= high && low < CPU_SETSIZE; ++low)
+	{
+	  if (low >= 0)
+	    CPU_SET (low, set);
+	}
+
+      if (c != ',')
+	break;
+    }
+
+  fclose (stream);
+
+  return 0;
+}
+#endif /* HAVE_AFFINITY */
+
+/* Process a work order.  */
+static void
+run_task (rs_task_t *task, rs_worker_t *worker)
+{
+  rs_workshop_t *workshop = worker->workshop;
+  rs_workshop_group_t *group;
+  rs_task_t job[1];
+  unsigned long long start = 0, stop;
+
+  /* Unpack work order.  */
+  memcpy (job, task, sizeof (rs_task_t));
+
+  /* Recycle the envelope.  */
+  free_task (task, workshop, worker);
+
+  if (workshop->timing)
+    {
+      start = now ();
+      record (worker->wait_histogram, start - job->stamp);
+    }
+
+  /* Start working.  */
+  ++worker->depth;
+
+  group = worker->group;
+  worker->group = job->group;
+
+  /* Skip cancelled work orders.  */
+  if (job->group == NULL || ! atomic_load_explicit (&job->group->cancelled, memory_order_relaxed))
+    {
+      if (job->loop != NULL)
+	run_range (job->loop, job->begin, job->end, worker);
+      else
+	job->fun (job->arg);
+    }
+
+  worker->group = group;
+
+  --worker->depth;
+
+  if (workshop->timing)
+    {
+      stop = now ();
+      record (worker->run_histogram, stop - start);
+
+      /* Don't count the time of nested work orders twice.  */
+      if (worker->depth == 0)
+	bump (worker->busy, stop - start);
+    }
+
+  bump (worker->completed, 1);
+
+  if (job->group != NULL)
+    leave_group (job->group, 1);
+
+  /* Busy workers service the timers, too.  */
+  if (worker->depth == 0)
+    expire_timers (workshop);
+}
+
+/* Add the statistics of WORKER to STATS.  */
+static void
+collect (rs_worker_t *worker, rs_workshop_worker_stats_t *stats)
+{
+  unsigned long long started, busy, idle = 0;
+  int k;
+
+  stats->submitted += atomic_load_explicit (&worker->submitted, memory_order_relaxed);
+  stats->completed += atomic_load_explicit (&worker->completed, memory_order_relaxed);
+
+  /* A worker is idle if it is not busy.  */
+  started = atomic_load_explicit (&worker->started, memory_order_relaxed);
+  busy = atomic_load_explicit (&worker->busy, memory_order_relaxed);
+  if (started != 0)
+    {
+      idle = now () - started;
+      idle = (idle > busy ? idle - busy : 0);
+    }
+
+  stats->busy_time += (double) busy / 1.0E9;
+  stats->idle_time += (double) idle / 1.0E9;
+
+  for (k = 0; k < RS_WORKSHOP_HISTOGRAM_SIZE; ++k)
+    {
+      stats->wait_histogram[k] += atomic_load_explicit (&worker->wait_histogram[k], memory_order_relaxed);
+      stats->run_histogram[k] += atomic_load_explicit (&worker->run_histogram[k], memory_order_relaxed);
+    }
+}
+
+/* Count a DURATION in nanoseconds in the logarithmic HISTOGRAM.  */
+static void
+record (atomic_size_t *histogram, unsigned long long duration)
+{
+  int k = 0;
+
+  while (duration > 1 && k < RS_WORKSHOP_HISTOGRAM_SIZE - 1)
+    {
+      duration >>= 1;
+      ++k;
+    }
+
+  bump (histogram[k], 1);
+}
+
+/* Return the value of a monotonic clock in nanoseconds.  */
+static unsigned long long
+now (void)
+{
+  struct timespec ts;
+
+  assert (clock_gettime (CLOCK_MONOTONIC, &ts) == 0);
+
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+/* Run the parallel loop LP over the indices BEGIN to END and wait
+   until it is done.  */
+static int
+loop (rs_workshop_t *workshop, rs_loop_t *lp, size_t begin, size_t end)
+{
+  lp->workshop = workshop;
+
+  lp->group->workshop = workshop;
+  atomic_init (&lp->group->pending, 0);
+  atomic_init (&lp->group->waiters, 0);
+  lp->group->level = LEVEL_NORMAL;
+  atomic_init (&lp->group->cancelled, 0);
+
+  /* Choose a grain size so that there are enough sub-ranges
+     to balance the work load.  */
+  if (lp->grain == 0)
+    {
+      lp->grain = (end - begin) / (8 * ((size_t) workshop->workers + 1));
+      if (lp->grain == 0)
+	lp->grain = 1;
+    }
+
+  /* The client processes the first sub-range.  */
+  run_range (lp, begin, end, current_worker (workshop));
+
+  join_group (lp->group);
+
+  /* See ‘rs_workshop_group_delete’.  */
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+  return 0;
+}
+
+/* Process the indices BEGIN to END of a parallel loop.
+
+   The range is processed in steps of the grain size.  Before each
+   step, the upper half of the remaining range is split off as a new
+   work order if there are idle workers.  Thus, idle workers pick up
+   the remaining halves and busy workers do not waste time with
+   splitting.  */
+static void
+run_range (rs_loop_t *lp, size_t begin, size_t end, rs_worker_t *worker)
+{
+  rs_workshop_t *workshop = lp->workshop;
+  size_t k, mid, step;
+  char *acc = NULL;
+
+  if (lp->reduce != NULL)
+    {
+      k = (worker != NULL ? (size_t) worker->id : (size_t) workshop->slots);
+
+      acc = lp->acc + k * lp->stride;
+      lp->used[k] = 1;
+    }
+
+  while (begin < end)
+    {
+      if (end - begin > lp->grain
+	  && atomic_load_explicit (&workshop->queued, memory_order_relaxed)
+	  < (size_t) (atomic_load_explicit (&workshop->idle, memory_order_relaxed)
+		      + atomic_load_explicit (&workshop->helpers, memory_order_relaxed)))
+	{
+	  mid = begin + (end - begin) / 2;
+
+	  if (spawn_range (lp, mid, end, worker) == 0)
+	    {
+	      end = mid;
+	      continue;
+	    }
+	}
+
+      step = (end - begin > lp->grain ? lp->grain : end - begin);
+
+      if (acc != NULL)
+	lp->reduce (begin, begin + step, acc, lp->arg);
+      else
+	lp->fun (begin, begin + step, lp->arg);
+
+      begin += step;
+    }
+}
+
+/* Place a work order for the indices BEGIN to END of a parallel
+   loop.  */
+static int
+spawn_range (rs_loop_t *lp, size_t begin, size_t end, rs_worker_t *worker)
+{
+  rs_workshop_t *workshop = lp->workshop;
+  rs_task_t *task;
+
+  task = alloc_task (workshop, worker);
+  if (task == NULL)
+    return -1;
+
+  task->fun = NULL;
+  task->arg = NULL;
+  task->group = lp->group;
+  task->loop = lp;
+  task->begin = begin;
+  task->end = end;
+
+  atomic_fetch_add (&lp->group->pending, 1);
+
+  if (push_task (task, 1, LEVEL_NORMAL, workshop) != 0)
+    {
+      leave_group (lp->group, 1);
+      free_task (task, workshop, worker);
+      return -1;
+    }
+
+  return 0;
+}
+
+/* Return the worker object of the calling thread if it is a worker
+   of WORKSHOP.  Otherwise, return a null pointer.  */
+static rs_worker_t *
+current_worker (rs_workshop_t *workshop)
+{
+  rs_worker_t *worker;
+
+  worker = pthread_getspecific (worker_key);
+  if (worker != NULL && worker->workshop != workshop)
+    worker = NULL;
+
+  return worker;
+}
+
+/* Return non-zero if any work order is invalid.  */
+static int
+check_orders (rs_work_order_t const *orders, size_t count)
+{
+  size_t k;
+
+  if (orders == NULL && count > 0)
+    return -1;
+
+  for (k = 0; k < count; ++k)
+    {
+      if (orders[k].fun == NULL)
+	return -1;
+    }
+
+  return 0;
+}
+
+/* Place COUNT work orders as members of GROUP with priority level
+   LEVEL.  Argument GROUP may be a null pointer.  */
+static int
+place (rs_workshop_t *workshop, rs_workshop_group_t *group, int level, rs_work_order_t const *orders, size_t count)
+{
+  rs_worker_t *worker;
+  rs_task_t *first, *task;
+  size_t k;
+
+  if (count == 0)
+    return 0;
+
+  if (workshop->workers == 0)
+    {
+      atomic_fetch_add_explicit (&workshop->submitted, count, memory_order_relaxed);
+
+      for (k = 0; k < count; ++k)
+	{
+	  /* Skip cancelled work orders.  */
+	  if (group == NULL || ! atomic_load (&group->cancelled))
+	    orders[k].fun (orders[k].arg);
+
+	  atomic_fetch_add_explicit (&workshop->completed, 1, memory_order_relaxed);
+	}
+
+      return 0;
+    }
+
+  worker = current_worker (workshop);
+
+  /* Put the work orders in envelopes.  The envelopes are linked
+     in reverse order.  */
+  first = NULL;
+  for (k = count; k > 0; --k)
+    {
+      task = alloc_task (workshop, worker);
+      if (task == NULL)
+	goto failure;
+
+      task->link = first;
+      task->fun = orders[k - 1].fun;
+      task->arg = orders[k - 1].arg;
+      task->group = group;
+      task->loop = NULL;
+
+      first = task;
+    }
+
+  /* The group has to know about the work orders before a worker
+     can finish them.  */
+  if (group != NULL)
+    atomic_fetch_add (&group->pending, count);
+
+  if (push_task (first, count, level, workshop) != 0)
+    {
+      if (group != NULL)
+	leave_group (group, count);
+
+      goto failure;
+    }
+
+  return 0;
+
+ failure:
+
+  while (first != NULL)
+    {
+      task = first;
+      first = task->link;
+
+      free_task (task, workshop, worker);
+    }
+
+  return -1;
+}
+
+/* Schedule the timer TIMER.  Return value is zero on success.
+   Otherwise, set ‘errno’ and return -1.  */
+static int
+add_timer (rs_workshop_timer_t *timer)
+{
+  rs_workshop_t *workshop = timer->workshop;
+  size_t n;
+
+  /* Someone has to service the timers.  */
+  if (workshop->workers == 0)
+    {
+      errno = ENOSYS;
+      return -1;
+    }
+
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+  n = atomic_load (&workshop->timers);
+  if (n == workshop->heap_size)
+    {
+      rs_workshop_timer_t **heap;
+      size_t size;
+
+      size = (n > 0 ? 2 * n : 16);
+
+      heap = realloc (workshop->heap, size * sizeof (rs_workshop_timer_t *));
+      if (heap == NULL)
+	{
+	  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+	  return -1;
+	}
+
+      workshop->heap = heap;
+      workshop->heap_size = size;
+    }
+
+  workshop->heap[n] = timer;
+  timer->index = n;
+
+  atomic_store (&workshop->timers, n + 1);
+
+  sift_up (workshop, n);
+
+  /* Wake up an idle worker if the new timer is the next timer.
+     Either the waiting worker adjusts its timeout or another worker
+     starts waiting for the timer.  */
+  if (timer->index == 0)
+    {
+      atomic_store (&workshop->next_due, timer->due);
+
+      if (atomic_load (&workshop->idle) > 0)
+	assert (pthread_cond_broadcast (workshop->work_cond) == 0);
+    }
+
+  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+  return 0;
+}
+
+/* Place work orders for all expired timers.  */
+static void
+expire_timers (rs_workshop_t *workshop)
+{
+  rs_work_order_t order[TIMER_BATCH];
+  rs_workshop_timer_t *flight[TIMER_BATCH];
+  unsigned long long t;
+  size_t n, k;
+
+  if (atomic_load_explicit (&workshop->timers, memory_order_relaxed) == 0)
+    return;
+
+  t = now ();
+
+  while (t >= atomic_load_explicit (&workshop->next_due, memory_order_relaxed))
+    {
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+      n = 0;
+      while (n < TIMER_BATCH
+	     && atomic_load (&workshop->timers) > 0
+	     && workshop->heap[0]->due <= t)
+	{
+	  rs_workshop_timer_t *timer = workshop->heap[0];
+
+	  order[n].fun = timer->fun;
+	  order[n].arg = timer->arg;
+	  flight[n] = NULL;
+
+	  if (timer->period > 0)
+	    {
+	      /* The timer can be cancelled as soon as the pool lock
+		 is released.  Thus, mark the work order as in flight
+		 until it is placed, see ‘rs_workshop_timer_cancel’.  */
+	      flight[n] = timer;
+	      ++timer->flight;
+
+	      /* Skip missed periods.  */
+	      timer->due += timer->period;
+	      if (timer->due <= t)
+		timer->due = t + timer->period;
+
+	      sift_down (workshop, 0);
+	    }
+	  else
+	    {
+	      remove_timer (workshop, 0);
+
+	      free (timer);
+	    }
+
+	  ++n;
+	}
+
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+      if (n == 0)
+	break;
+
+      /* Work orders of a worker are only rejected if there is not
+	 enough memory.  */
+      if (place (workshop, NULL, LEVEL_NORMAL, order, n) != 0)
+	{
+	  done_timers (workshop, flight, n);
+
+	  for (k = 0; k < n; ++k)
+	    order[k].fun (order[k].arg);
+	}
+      else
+	done_timers (workshop, flight, n);
+    }
+}
+
+/* The work orders of the first N timers of the array TIMER are
+   placed.  Null pointers are ignored.  Wake up threads cancelling
+   one of the timers.  */
+static void
+done_timers (rs_workshop_t *workshop, rs_workshop_timer_t **timer, size_t n)
+{
+  size_t k;
+  int wake = 0;
+
+  for (k = 0; k < n; ++k)
+    {
+      if (timer[k] != NULL)
+	break;
+    }
+
+  if (k == n)
+    return;
+
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+  for (; k < n; ++k)
+    {
+      if (timer[k] == NULL)
+	continue;
+
+      /* A periodic timer is only removed from the heap when it is
+	 cancelled.  */
+      if (--timer[k]->flight == 0 && timer[k]->index == NO_INDEX)
+	wake = 1;
+    }
+
+  if (wake)
+    assert (pthread_cond_broadcast (workshop->done_cond) == 0);
+
+  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+}
+
+/* Move the timer at position K of the heap towards the root.
+   The caller must hold the pool lock.  */
+static void
+sift_up (rs_workshop_t *workshop, size_t k)
+{
+  rs_workshop_timer_t **heap = workshop->heap;
+  rs_workshop_timer_t *timer = heap[k];
+
+  while (k > 0)
+    {
+      size_t parent = (k - 1) / 2;
+
+      if (heap[parent]->due <= timer->due)
+	break;
+
+      heap[k] = heap[parent];
+      heap[k]->index = k;
+
+      k = parent;
+    }
+
+  heap[k] = timer;
+  timer->index = k;
+
+  if (k == 0)
+    atomic_store (&workshop->next_due, timer->due);
+}
+
+/* Move the timer at position K of the heap towards the leaves.
+   The caller must hold the pool lock.  */
+static void
+sift_down (rs_workshop_t *workshop, size_t k)
+{
+  rs_workshop_timer_t **heap = workshop->heap;
+  rs_workshop_timer_t *timer = heap[k];
+  size_t n = atomic_load (&workshop->timers);
+
+  while (1)
+    {
+      size_t child = 2 * k + 1;
+
+      if (child >= n)
+	break;
+
+      if (child + 1 < n && heap[child + 1]->due < heap[child]->due)
+	++child;
+
+      if (timer->due <= heap[child]->due)
+	break;
+
+      heap[k] = heap[child];
+      heap[k]->index = k;
+
+      k = child;
+    }
+
+  heap[k] = timer;
+  timer->index = k;
+
+  atomic_store (&workshop->next_due, heap[0]->due);
+}
+
+/* Remove the timer at position K from the heap.  The caller must
+   hold the pool lock.  */
+static void
+remove_timer (rs_workshop_t *workshop, size_t k)
+{
+  rs_workshop_timer_t **heap = workshop->heap;
+  size_t n = atomic_load (&workshop->timers) - 1;
+
+  heap[k]->index = NO_INDEX;
+
+  atomic_store (&workshop->timers, n);
+
+  if (k < n)
+    {
+      heap[k] = heap[n];
+      heap[k]->index = k;
+
+      if (k > 0 && heap[k]->due < heap[(k - 1) / 2]->due)
+	sift_up (workshop, k);
+      else
+	sift_down (workshop, k);
+    }
+
+  if (n == 0)
+    atomic_store (&workshop->next_due, ULLONG_MAX);
+  else
+    atomic_store (&workshop->next_due, heap[0]->due);
+}
+
+/* Convert SECONDS into nanoseconds.  Negative values are treated
+   like zero.  */
+static unsigned long long
+seconds_to_ns (double seconds)
+{
+  if (! (seconds > 0.0))
+    return 0;
+
+  /* About 584 years.  */
+  if (seconds >= 1.8E10)
+    return ULLONG_MAX / 2;
+
+  return (unsigned long long) (seconds * 1.0E9);
+}
+
+/* Process the work order of the future FUTURE.  */
+static void
+run_future (void *arg)
+{
+  rs_workshop_future_t *future = arg;
+
+  future->result = future->fun (future->arg);
+}
+
+/* Place a work order for the node NODE of a task graph.  */
+static void
+ready_node (rs_workshop_node_t *node)
+{
+  rs_workshop_graph_t *graph = node->graph;
+  rs_work_order_t order[1];
+
+  order->fun = run_node;
+  order->arg = node;
+
+  /* If the work order is rejected, process the node immediately.
+     Otherwise, the graph would never finish.  */
+  if (place (graph->group->workshop, graph->group, graph->group->level, order, 1) != 0)
+    run_node (node);
+}
+
+/* Process the node NODE of a task graph and place work orders for
+   all successors that become ready to run.  The successors become
+   members of the task group before the work order of NODE leaves
+   the task group.  */
+static void
+run_node (void *arg)
+{
+  rs_workshop_node_t *node = arg;
+  rs_workshop_graph_t *graph = node->graph;
+  rs_workshop_node_t **succ;
+  size_t count, k;
+
+  node->fun (node->arg);
+
+  /* No more successors can be added after the node is done.  */
+  assert (pthread_mutex_lock (graph->lock) == 0);
+
+  node->done = 1;
+
+  succ = node->succ;
+  count = node->succ_count;
+
+  assert (pthread_mutex_unlock (graph->lock) == 0);
+
+  for (k = 0; k < count; ++k)
+    {
+      if (atomic_fetch_sub (&succ[k]->deps, 1) == 1)
+	ready_node (succ[k]);
+    }
+}
+
+/* Remove COUNT finished work orders from GROUP.  */
+static void
+leave_group (rs_workshop_group_t *group, size_t count)
+{
+  rs_workshop_t *workshop = group->workshop;
+  size_t n;
+
+  /* Unless these are the last work orders of the group, there is
+     no need to take the pool lock.  */
+  n = atomic_load (&group->pending);
+  while (n > count)
+    {
+      if (atomic_compare_exchange_weak (&group->pending, &n, n - count))
+	return;
+    }
+
+  /* Otherwise, the group may be deleted as soon as the counter drops
+     to zero.  Thus, do not touch the group after releasing the pool
+     lock.  */
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+  if (atomic_fetch_sub (&group->pending, count) == count
+      && atomic_load (&group->waiters) > 0)
+    {
+      assert (pthread_cond_broadcast (workshop->done_cond) == 0);
+
+      /* Waiting workers wait for new work orders, too.  */
+      if (atomic_load (&workshop->helpers) > 0)
+	assert (pthread_cond_broadcast (workshop->work_cond) == 0);
+    }
+
+  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+}
+
+/* Wait until all work orders of GROUP are processed.  The caller
+   must hold the pool lock.  */
+static void
+wait_group (rs_workshop_group_t *group)
 {
-  if (workshop->workers > 0)
-    shutdown (workshop);
+  rs_workshop_t *workshop = group->workshop;
+
+  atomic_fetch_add (&group->waiters, 1);
+
+  while (atomic_load (&group->pending) != 0)
+    assert (pthread_cond_wait (workshop->done_cond, workshop->pool_lock) == 0);
+
+  atomic_fetch_sub (&group->waiters, 1);
+}
+
+/* Wait until all work orders of GROUP are processed.  If the calling
+   thread is a worker, it processes other work orders in the meantime.
+   Otherwise, the worker would block and nested work orders could not
+   wait for their own work orders without a deadlock.  */
+static void
+join_group (rs_workshop_group_t *group)
+{
+  rs_workshop_t *workshop = group->workshop;
+  rs_worker_t *worker;
+
+  if (atomic_load (&group->pending) == 0)
+    return;
+
+  worker = current_worker (workshop);
+  if (worker != NULL)
+    help (worker, group);
+  else
+    {
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+      wait_group (group);
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+    }
+}
+
+/* Process work orders until all work orders of GROUP are processed.
+   If GROUP is a null pointer, process work orders until all other
+   workers are idle.  */
+static void
+help (rs_worker_t *worker, rs_workshop_group_t *group)
+{
+  rs_workshop_t *workshop = worker->workshop;
+  rs_task_t *task;
+  int done;
+
+  while (1)
+    {
+      task = find_task (worker);
+      if (task != NULL)
+	{
+	  run_task (task, worker);
+	  continue;
+	}
+
+      if (! helped (workshop, group) && linger (workshop) != 0)
+	continue;
+
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+      if (group != NULL)
+	atomic_fetch_add (&group->waiters, 1);
+
+      /* Wait for new work orders or until we are done.  */
+      while (! (done = helped (workshop, group))
+	     && atomic_load (&workshop->queued) == 0)
+	{
+	  atomic_fetch_add (&workshop->helpers, 1);
+	  assert (pthread_cond_wait (workshop->work_cond, workshop->pool_lock) == 0);
+	  atomic_fetch_sub (&workshop->helpers, 1);
+	}
+
+      if (group != NULL)
+	atomic_fetch_sub (&group->waiters, 1);
+
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+      if (done)
+	break;
+    }
+}
+
+/* Return non-zero if a waiting worker is done, see ‘help’.  */
+static int
+helped (rs_workshop_t *workshop, rs_workshop_group_t *group)
+{
+  if (group != NULL)
+    return (atomic_load (&group->pending) == 0);
+
+  return (atomic_load (&workshop->queued) == 0
+	  && (atomic_load (&workshop->idle)
+	      + atomic_load (&workshop->helpers)
+	      == workshop->workers - 1));
+}
+
+/* Get an envelope for a work order.  WORKER is the calling worker
+   or a null pointer.  */
+static rs_task_t *
+alloc_task (rs_workshop_t *workshop, rs_worker_t *worker)
+{
+  rs_task_t *task;
+
+  if (worker != NULL)
+    {
+      if (worker->cache == NULL)
+	{
+	  rs_task_t *last = NULL;
+
+	  /* Refill the cache from the envelope store.  */
+	  assert (pthread_mutex_lock (workshop->store_lock) == 0);
+
+	  if (workshop->store == NULL)
+	    grow_store (workshop);
+
+	  worker->cache = workshop->store;
+	  for (task = workshop->store; task != NULL && worker->cached < CACHE_SIZE / 2; task = task->link)
+	    {
+	      ++worker->cached;
+	      last = task;
+	    }
+
+	  if (last != NULL)
+	    {
+	      workshop->store = last->link;
+	      last->link = NULL;
+	    }
+
+	  assert (pthread_mutex_unlock (workshop->store_lock) == 0);
+
+	  if (worker->cache == NULL)
+	    return NULL;
+	}
+
+      task = worker->cache;
+      worker->cache = task->link;
+      --worker->cached;
+    }
+  else
+    {
+      assert (pthread_mutex_lock (workshop->store_lock) == 0);
+
+      task = workshop->store;
+      if (task == NULL)
+	task = grow_store (workshop);
+      if (task != NULL)
+	workshop->store = task->link;
+
+      assert (pthread_mutex_unlock (workshop->store_lock) == 0);
+
+      if (task == NULL)
+	return NULL;
+    }
+
+  task->link = NULL;
+
+  return task;
+}
+
+/* Recycle an envelope.  WORKER is the calling worker or a null
+   pointer.  */
+static void
+free_task (rs_task_t *task, rs_workshop_t *workshop, rs_worker_t *worker)
+{
+  if (worker != NULL)
+    {
+      task->link = worker->cache;
+      worker->cache = task;
+
+      if (++worker->cached > CACHE_SIZE)
+	{
+	  rs_task_t *first, *last;
+
+	  /* Return half of the cache to the envelope store.  */
+	  first = last = worker->cache;
+	  while (--worker->cached > CACHE_SIZE / 2)
+	    last = last->link;
+
+	  worker->cache = last->link;
+
+	  assert (pthread_mutex_lock (workshop->store_lock) == 0);
+
+	  last->link = workshop->store;
+	  workshop->store = first;
+
+	  assert (pthread_mutex_unlock (workshop->store_lock) == 0);
+	}
+    }
+  else
+    {
+      assert (pthread_mutex_lock (workshop->store_lock) == 0);
+
+      task->link = workshop->store;
+      workshop->store = task;
+
+      assert (pthread_mutex_unlock (workshop->store_lock) == 0);
+    }
+}
+
+/* Add a slab to the envelope store.  The caller must hold the store
+   lock.  Return value is the first free envelope, or a null pointer
+   if the system ran out of memory.  */
+static rs_task_t *
+grow_store (rs_workshop_t *workshop)
+{
+  rs_slab_t *slab;
+  int k;
+
+  slab = malloc (sizeof (rs_slab_t));
+  if (slab == NULL)
+    return NULL;
+
+  slab->link = workshop->slab;
+  workshop->slab = slab;
+
+  ++workshop->slabs;
+
+  /* Link the envelopes.  */
+  for (k = 0; k < SLAB_SIZE - 1; ++k)
+    slab->task[k].link = slab->task + k + 1;
+
+  slab->task[k].link = workshop->store;
+  workshop->store = slab->task;
+
+  return workshop->store;
+}
+
+/* Add work orders to the queue.  Argument TASK is a list of COUNT
+   work orders linked by the ‘link’ member.  Argument LEVEL is the
+   priority level of the work orders.
+
+   Work orders with normal priority placed by a worker are added to
+   the local deque of that worker.  Any other work order is added to
+   the injection queue of its priority level.  */
+static int
+push_task (rs_task_t *task, size_t count, int level, rs_workshop_t *workshop)
+{
+  rs_worker_t *worker;
+  int retval = 0;
+
+  worker = current_worker (workshop);
+  if (worker != NULL && level == LEVEL_NORMAL)
+    {
+      /* Work orders of a worker are always accepted, even if
+	 ‘rs_workshop_wait’ is executing.  Otherwise, a work order
+	 could not spawn further work orders.  */
+      enqueue (task, count, workshop, worker);
+
+      if (push_local (task, count, worker) != 0)
+	{
+	  atomic_fetch_sub (&workshop->queued, count);
+	  bump (worker->submitted, - count);
+	  return -1;
+	}
+
+      /* Activate idle workers.  The pool lock is required to not
+	 lose the signal if a worker is about to wait.  */
+      if (atomic_load (&workshop->idle) > 0
+	  || atomic_load (&workshop->helpers) > 0
+	  || understaffed (workshop))
+	{
+	  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+	  wake (workshop, count);
+	  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+	}
+
+      return 0;
+    }
+
+  if (workshop->capacity > 0)
+    {
+      rs_task_t *tem;
+
+      /* Make room for the work orders.  Work orders of a worker
+	 are not limited.  */
+      if (worker == NULL && reserve (workshop, count) != 0)
+	return -1;
+
+      for (tem = task; tem != NULL; tem = tem->link)
+	tem->reserved = (worker == NULL);
+    }
+
+  if (worker == NULL && level == LEVEL_NORMAL && workshop->ring != NULL)
+    {
+      rs_task_t *next;
+      size_t rest = count;
+
+      if (atomic_load (&workshop->waiting) != 0)
+	{
+	  if (workshop->capacity > 0)
+	    release (workshop, count);
+
+	  /* Reject work order.  */
+	  errno = EBUSY;
+	  return -1;
+	}
+
+      enqueue (task, count, workshop, NULL);
+
+      /* Workers take work orders from the lock-free queue before
+	 the locked queue.  Thus, once work orders spilled into the
+	 locked queue, further work orders have to be appended to the
+	 locked queue, too.  Otherwise, they would overtake the spilled
+	 work orders.  A worker may recycle the envelope as soon as it
+	 is in the queue.  Thus, fetch the next envelope first.  */
+      if (atomic_load (&workshop->injected[LEVEL_NORMAL]) == 0)
+	{
+	  for (; task != NULL; task = next, --rest)
+	    {
+	      next = task->link;
+
+	      if (ring_push (workshop->ring, task) != 0)
+		break;
+	    }
+	}
+
+      if (task == NULL)
+	{
+	  /* Activate idle workers.  */
+	  if (atomic_load (&workshop->idle) > 0
+	      || atomic_load (&workshop->helpers) > 0
+	      || understaffed (workshop))
+	    {
+	      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+	      wake (workshop, count);
+	      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+	    }
+
+	  return 0;
+	}
+
+      /* The lock-free queue is full or work orders spilled before.
+	 Append the remaining work orders to the locked queue.  */
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+      append_injected (task, rest, level, workshop);
+      wake (workshop, count);
+
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+      return 0;
+    }
+
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+  if (worker == NULL && atomic_load (&workshop->waiting) != 0)
+    {
+      /* Reject work order.  */
+      errno = EBUSY;
+      retval = -1;
+    }
+  else
+    {
+      enqueue (task, count, workshop, worker);
+
+      append_injected (task, count, level, workshop);
+
+      /* Activate idle workers.  */
+      wake (workshop, count);
+    }
+
+  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+  if (retval != 0 && workshop->capacity > 0)
+    release (workshop, count);
+
+  return retval;
+}
+
+/* Account for COUNT work orders about to be queued.  Argument TASK
+   is a list of work orders linked by the ‘link’ member.  Argument
+   WORKER is the worker placing the work orders, or a null pointer.  */
+static void
+enqueue (rs_task_t *task, size_t count, rs_workshop_t *workshop, rs_worker_t *worker)
+{
+  size_t n, peak;
+
+  if (workshop->timing)
+    {
+      unsigned long long stamp = now ();
+
+      for (; task != NULL; task = task->link)
+	task->stamp = stamp;
+    }
+
+  if (worker != NULL)
+    bump (worker->submitted, count);
+  else
+    atomic_fetch_add_explicit (&workshop->submitted, count, memory_order_relaxed);
+
+  n = atomic_fetch_add (&workshop->queued, count) + count;
+
+  peak = atomic_load_explicit (&workshop->peak, memory_order_relaxed);
+  while (n > peak)
+    {
+      if (atomic_compare_exchange_weak (&workshop->peak, &peak, n))
+	break;
+    }
+}
+
+/* Reserve COUNT places in a bounded injection queue.  Wait until
+   there is space or fail with ‘EAGAIN’, depending on the mode of
+   the queue.  A batch of work orders exceeding the capacity of the
+   queue is accepted if the queue is empty.  Return value is zero on
+   success.  Otherwise, set ‘errno’ and return -1.  */
+static int
+reserve (rs_workshop_t *workshop, size_t count)
+{
+  size_t n;
+
+  n = atomic_load (&workshop->backlog);
+  while (n == 0 || n + count <= workshop->capacity)
+    {
+      if (atomic_compare_exchange_weak (&workshop->backlog, &n, n + count))
+	return 0;
+    }
+
+  if (! workshop->block)
+    {
+      errno = EAGAIN;
+      return -1;
+    }
+
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+  /* Announce the waiting client before checking again.  Otherwise,
+     the last worker taking a work order from the queue may miss
+     it.  */
+  atomic_fetch_add (&workshop->blocked, 1);
+
+  while (1)
+    {
+      n = atomic_load (&workshop->backlog);
+      while (n == 0 || n + count <= workshop->capacity)
+	{
+	  if (atomic_compare_exchange_weak (&workshop->backlog, &n, n + count))
+	    goto done;
+	}
+
+      assert (pthread_cond_wait (workshop->space_cond, workshop->pool_lock) == 0);
+    }
+
+ done:
+
+  atomic_fetch_sub (&workshop->blocked, 1);
+
+  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+  return 0;
+}
+
+/* Release COUNT places in a bounded injection queue.  */
+static void
+release (rs_workshop_t *workshop, size_t count)
+{
+  atomic_fetch_sub (&workshop->backlog, count);
+
+  if (atomic_load (&workshop->blocked) > 0)
+    {
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+      assert (pthread_cond_broadcast (workshop->space_cond) == 0);
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+    }
+}
+
+/* Append COUNT work orders to the locked injection queue of the
+   priority level LEVEL.  Argument TASK is a list of work orders
+   linked by the ‘link’ member.  The caller must hold the pool lock.  */
+static void
+append_injected (rs_task_t *task, size_t count, int level, rs_workshop_t *workshop)
+{
+  rs_task_t *last;
+
+  for (last = task; last->link != NULL; last = last->link)
+    ;
+
+  /* Append work orders to the queue.  */
+  if (workshop->first[level] == NULL)
+    {
+      workshop->first[level] = task;
+      workshop->last[level] = last;
+
+      /* Circular list.  */
+      last->link = task;
+    }
+  else
+    {
+      workshop->last[level]->link = task;
+      last->link = workshop->first[level];
+      workshop->last[level] = last;
+    }
+
+  atomic_fetch_add (&workshop->injected[level], count);
+}
+
+/* Activate up to COUNT idle workers.  The caller must hold the pool
+   lock.  */
+static void
+wake (rs_workshop_t *workshop, size_t count)
+{
+  int idle;
+
+  /* Start another worker if work orders pile up.  Auto-scaling is
+     a hint, thus ignore errors.  */
+  if (understaffed (workshop) && ! workshop->closing)
+    hire (workshop);
+
+  idle = atomic_load (&workshop->idle) + atomic_load (&workshop->helpers);
+  if (idle <= 0)
+    return;
+
+  if (count >= (size_t) idle)
+    assert (pthread_cond_broadcast (workshop->work_cond) == 0);
+  else
+    {
+      while (count-- > 0)
+	assert (pthread_cond_signal (workshop->work_cond) == 0);
+    }
+}
+
+/* Get a work order for WORKER.  If there is nothing to do, wait
+   until there is something to do.  Return value is a null pointer
+   if the worker shall quit.  */
+static rs_task_t *
+pop_task (rs_worker_t *worker)
+{
+  rs_workshop_t *workshop = worker->workshop;
+  rs_task_t *task = NULL;
+  unsigned long long since;
+  int retire;
+
+  while (1)
+    {
+      expire_timers (workshop);
 
-  if (workshop->worker != NULL)
-    free (workshop->worker);
+      task = find_task (worker);
+      if (task != NULL)
+	return task;
 
-  if (workshop->rollback >= 3)
-    assert (pthread_cond_destroy (workshop->idle_cond) == 0);
+      if (linger (workshop) != 0)
+	continue;
 
-  if (workshop->rollback >= 2)
-    assert (pthread_cond_destroy (workshop->work_cond) == 0);
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
 
-  if (workshop->rollback >= 1)
-    assert (pthread_mutex_destroy (workshop->pool_lock) == 0);
+      /* Looking for a job.  */
+      atomic_fetch_add (&workshop->idle, 1);
+
+      if (atomic_load (&workshop->waiting) != 0)
+	{
+	  assert (pthread_cond_broadcast (workshop->idle_cond) == 0);
+
+	  /* Waiting workers wait for idle co-workers, too.  */
+	  if (atomic_load (&workshop->helpers) > 0)
+	    assert (pthread_cond_broadcast (workshop->work_cond) == 0);
+	}
+
+      since = (workshop->idle_timeout > 0 ? now () : 0);
+      retire = 0;
+
+      while (atomic_load (&workshop->queued) == 0 && ! workshop->closing)
+	{
+	  unsigned long long due, limit;
+	  struct timespec ts;
+	  int keeper, err;
+
+	  /* Retire surplus workers.  */
+	  if (atomic_load (&workshop->workers) > atomic_load (&workshop->target))
+	    {
+	      retire = 1;
+	      break;
+	    }
+
+	  /* One idle worker waits for the next timer.  */
+	  keeper = (atomic_load (&workshop->timers) != 0 && ! workshop->timekeeper);
+
+	  due = (keeper ? atomic_load (&workshop->next_due) : ULLONG_MAX);
+	  if (keeper && due <= now ())
+	    break;
+
+	  /* Retire workers idle for too long.  */
+	  if (workshop->idle_timeout > 0
+	      && atomic_load (&workshop->workers) > workshop->min_workers)
+	    {
+	      limit = since + workshop->idle_timeout;
+	      if (limit <= now ())
+		{
+		  retire = 1;
+		  break;
+		}
+
+	      if (limit < due)
+		due = limit;
+	    }
+
+	  if (due == ULLONG_MAX)
+	    {
+	      assert (pthread_cond_wait (workshop->work_cond, workshop->pool_lock) == 0);
+	      continue;
+	    }
+
+	  ts.tv_sec = (time_t) (due / 1000000000ULL);
+	  ts.tv_nsec = (long) (due % 1000000000ULL);
+
+	  if (keeper)
+	    workshop->timekeeper = 1;
+
+	  err = pthread_cond_timedwait (workshop->work_cond, workshop->pool_lock, &ts);
+
+	  if (keeper)
+	    workshop->timekeeper = 0;
+
+	  assert (err == 0 || err == ETIMEDOUT);
+	}
+
+      /* There is something to do.  */
+      atomic_fetch_sub (&workshop->idle, 1);
+
+      if (retire)
+	{
+	  atomic_fetch_sub (&workshop->workers, 1);
+	  worker->state = RETIRED;
+
+	  /* The number of idle workers changed.  */
+	  if (atomic_load (&workshop->waiting) != 0)
+	    assert (pthread_cond_broadcast (workshop->idle_cond) == 0);
+	}
+
+      /* Hand over waiting for the next timer to another idle
+	 worker.  */
+      if (atomic_load (&workshop->timers) != 0
+	  && atomic_load (&workshop->idle) > 0)
+	assert (pthread_cond_broadcast (workshop->work_cond) == 0);
+
+      if (workshop->closing || retire)
+	{
+	  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+
+	  return NULL;
+	}
+
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+    }
 }
 
-/* Start function for a worker.  */
-static void *
-worker_thread (rs_workshop_t *workshop)
+/* Wait a while for new work orders before going to sleep, see the
+   idle policy.  Return value is non-zero if there are new work
+   orders.  */
+static int
+linger (rs_workshop_t *workshop)
 {
-  rs_task_t *task;
-  rs_task_t job[1];
+  int k;
 
-  while (1)
+  for (k = 0; k < workshop->spin; ++k)
     {
-      task = pop_task (workshop);
-      if (task == NULL)
-	break;
+      if (atomic_load_explicit (&workshop->queued, memory_order_relaxed) != 0)
+	return 1;
 
-      /* Unpack work order.  */
-      memcpy (job, task, sizeof (rs_task_t));
+      cpu_relax ();
+    }
 
-      /* Throw away the envelope.  */
-      free (task);
+  for (k = 0; k < workshop->yield; ++k)
+    {
+      if (atomic_load_explicit (&workshop->queued, memory_order_relaxed) != 0)
+	return 1;
 
-      /* Start working.  */
-      job->fun (job->arg);
+      sched_yield ();
     }
 
-  return NULL;
+  return 0;
 }
 
-/* Add a work order to the queue.  */
-static int
-push_task (rs_task_t *task, rs_workshop_t *workshop)
+/* Search all queues for a work order.  Return value is a null
+   pointer if there is nothing to do.  */
+static rs_task_t *
+find_task (rs_worker_t *worker)
 {
-  int retval = 0;
+  rs_workshop_t *workshop = worker->workshop;
+  rs_task_t *task;
 
-  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+  if (atomic_load (&workshop->queued) == 0)
+    return NULL;
+
+  task = NULL;
 
-  if (workshop->waiting)
+  /* Prefer high priority work orders, but every so often consider
+     other work orders first.  Likewise, consider low priority work
+     orders first if they have been passed over too often.  */
+  if (atomic_load_explicit (&workshop->injected[LEVEL_HIGH], memory_order_relaxed) != 0)
     {
-      /* Reject work order.  */
-      errno = EBUSY;
-      retval = -1;
+      if (atomic_fetch_add_explicit (&workshop->streak, 1, memory_order_relaxed) < PRIORITY_LIMIT)
+	task = take_level (workshop, LEVEL_HIGH);
+      else
+	atomic_store_explicit (&workshop->streak, 0, memory_order_relaxed);
     }
-  else
+
+  if (task == NULL && atomic_load_explicit (&workshop->injected[LEVEL_LOW], memory_order_relaxed) != 0)
     {
-      /* Append work order to the queue.  */
-      if (workshop->first == NULL)
+      if (atomic_fetch_add_explicit (&workshop->aging, 1, memory_order_relaxed) >= PRIORITY_LIMIT)
 	{
-	  workshop->first = task;
-	  workshop->last = task;
+	  atomic_store_explicit (&workshop->aging, 0, memory_order_relaxed);
 
-	  /* Circular list.  */
-	  task->link = task;
+	  task = take_level (workshop, LEVEL_LOW);
 	}
-      else
+    }
+
+  /* Prefer local work orders, then work orders placed by clients,
+     and steal from co-workers as a last resort.  */
+  if (task == NULL)
+    task = pop_local (worker);
+  if (task == NULL)
+    task = take_injected (workshop);
+  if (task == NULL)
+    task = steal (worker);
+  if (task == NULL)
+    task = take_level (workshop, LEVEL_HIGH);
+  if (task == NULL)
+    task = take_level (workshop, LEVEL_LOW);
+
+  if (task != NULL)
+    atomic_fetch_sub (&workshop->queued, 1);
+
+  return task;
+}
+
+/* Push work orders onto the bottom end of the local deque.  Argument
+   TASK is a list of COUNT work orders linked by the ‘link’ member.  */
+static int
+push_local (rs_task_t *task, size_t count, rs_worker_t *worker)
+{
+  assert (pthread_mutex_lock (worker->deque_lock) == 0);
+
+  if (worker->bottom - worker->top + count > worker->deque_size)
+    {
+      size_t n, k;
+      rs_task_t **p;
+
+      /* Double the size of the deque until it is large enough.  */
+      n = (worker->deque_size > 0 ? worker->deque_size : DEQUE_SIZE);
+      while (worker->bottom - worker->top + count > n)
+	n *= 2;
+
+      p = malloc (n * sizeof (rs_task_t *));
+      if (p == NULL)
 	{
-	  workshop->last->link = task;
-	  task->link = workshop->first;
-	  workshop->last = task;
+	  assert (pthread_mutex_unlock (worker->deque_lock) == 0);
+	  return -1;
 	}
 
-      /* Activate idle workers.  */
-      if (workshop->idle > 0)
-	assert (pthread_cond_signal (workshop->work_cond) == 0);
+      for (k = 0; worker->top + k != worker->bottom; ++k)
+	p[k] = worker->deque[(worker->top + k) & (worker->deque_size - 1)];
+
+      if (worker->deque != NULL)
+	free (worker->deque);
+
+      worker->deque = p;
+      worker->deque_size = n;
+      worker->top = 0;
+      worker->bottom = k;
     }
 
-  assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+  for (; task != NULL; task = task->link)
+    {
+      worker->deque[worker->bottom & (worker->deque_size - 1)] = task;
+      ++worker->bottom;
+    }
 
-  return retval;
+  atomic_fetch_add (&worker->count, count);
+
+  assert (pthread_mutex_unlock (worker->deque_lock) == 0);
+
+  return 0;
 }
 
-/* Get a work order from the queue.  */
+/* Pop a work order from the bottom end of the local deque.  */
 static rs_task_t *
-pop_task (rs_workshop_t *workshop)
+pop_local (rs_worker_t *worker)
 {
   rs_task_t *task = NULL;
 
-  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+  if (atomic_load_explicit (&worker->count, memory_order_relaxed) == 0)
+    return NULL;
 
-  /* Looking for a job.  */
-  ++workshop->idle;
+  assert (pthread_mutex_lock (worker->deque_lock) == 0);
 
-  if (workshop->waiting)
-    assert (pthread_cond_signal (workshop->idle_cond) == 0);
+  if (worker->bottom != worker->top)
+    {
+      --worker->bottom;
+      task = worker->deque[worker->bottom & (worker->deque_size - 1)];
 
-  while (workshop->first == NULL && ! workshop->closing)
-    assert (pthread_cond_wait (workshop->work_cond, workshop->pool_lock) == 0);
+      atomic_fetch_sub (&worker->count, 1);
+    }
 
-  /* There is something to do.  */
-  --workshop->idle;
+  assert (pthread_mutex_unlock (worker->deque_lock) == 0);
 
-  if (! workshop->closing)
+  return task;
+}
+
+/* Steal a work order from the top end of the deque of VICTIM.  */
+static rs_task_t *
+steal_local (rs_worker_t *victim)
+{
+  rs_task_t *task = NULL;
+
+  if (atomic_load_explicit (&victim->count, memory_order_relaxed) == 0)
+    return NULL;
+
+  /* Don't wait for a busy victim, try the next one.  */
+  if (pthread_mutex_trylock (victim->deque_lock) != 0)
+    return NULL;
+
+  if (victim->bottom != victim->top)
     {
-      task = workshop->first;
-      if (task != NULL)
+      task = victim->deque[victim->top & (victim->deque_size - 1)];
+      ++victim->top;
+
+      atomic_fetch_sub (&victim->count, 1);
+    }
+
+  assert (pthread_mutex_unlock (victim->deque_lock) == 0);
+
+  return task;
+}
+
+/* Steal a work order from a co-worker.  Victims are visited in
+   order starting at a random position.  If the workers are
+   distributed across NUMA nodes, victims on the same node are
+   visited first.  */
+static rs_task_t *
+steal (rs_worker_t *worker)
+{
+  rs_workshop_t *workshop = worker->workshop;
+  rs_task_t *task;
+  unsigned int x;
+  int start, pass, j, k;
+
+  if (workshop->slots < 2)
+    return NULL;
+
+  /* Xorshift pseudo-random number generator.  */
+  x = worker->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  worker->seed = x;
+
+  start = (int) (x % (unsigned int) workshop->slots);
+  for (pass = 0; pass < 2; ++pass)
+    {
+      j = start;
+      for (k = 0; k < workshop->slots; ++k, ++j)
 	{
-	  if (workshop->first == workshop->last)
-	    {
-	      /* This is the last task in the queue.  */
-	      workshop->first = NULL;
-	      workshop->last = NULL;
-	    }
-	  else
-	    {
-	      /* Two or more tasks.  */
-	      workshop->last->link = workshop->first = task->link;
-	    }
+	  if (j == workshop->slots)
+	    j = 0;
+
+	  if (j == worker->id)
+	    continue;
+
+	  /* First pass visits co-workers on the same node,
+	     second pass visits all other co-workers.  */
+	  if (workshop->nodes > 1
+	      && (workshop->worker[j].node == worker->node) != (pass == 0))
+	    continue;
+
+	  task = steal_local (workshop->worker + j);
+	  if (task != NULL)
+	    return task;
 	}
+
+      if (workshop->nodes < 2)
+	break;
     }
 
+  return NULL;
+}
+
+/* Remove a work order with normal priority from the injection
+   queue.  */
+static rs_task_t *
+take_injected (rs_workshop_t *workshop)
+{
+  rs_task_t *task = NULL;
+
+  if (workshop->ring == NULL)
+    return take_level (workshop, LEVEL_NORMAL);
+
+  task = ring_pop (workshop->ring);
+  if (task == NULL && atomic_load_explicit (&workshop->injected[LEVEL_NORMAL], memory_order_relaxed) != 0)
+    {
+      /* A client may have refilled the lock-free queue and spilled
+	 further work orders into the locked queue since the check
+	 above.  Clients only spill while holding the pool lock.
+	 Thus, check the lock-free queue again while holding the pool
+	 lock so that spilled work orders never overtake work orders
+	 in the lock-free queue, see ‘push_task’.  */
+      assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+      task = ring_pop (workshop->ring);
+      if (task == NULL)
+	task = unlink_level (workshop, LEVEL_NORMAL);
+
+      assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
+    }
+
+  /* Work orders in the lock-free queue are always placed by
+     clients.  */
+  if (task != NULL && workshop->capacity > 0 && task->reserved)
+    release (workshop, 1);
+
+  return task;
+}
+
+/* Remove a work order from the locked injection queue of the
+   priority level LEVEL.  */
+static rs_task_t *
+take_level (rs_workshop_t *workshop, int level)
+{
+  rs_task_t *task = NULL;
+
+  if (atomic_load_explicit (&workshop->injected[level], memory_order_relaxed) == 0)
+    return NULL;
+
+  assert (pthread_mutex_lock (workshop->pool_lock) == 0);
+
+  task = unlink_level (workshop, level);
+
   assert (pthread_mutex_unlock (workshop->pool_lock) == 0);
 
+  if (task != NULL && workshop->capacity > 0 && task->reserved)
+    release (workshop, 1);
+
+  return task;
+}
+
+/* Remove the first work order from the locked injection queue of
+   the priority level LEVEL.  The caller must hold the pool lock.  */
+static rs_task_t *
+unlink_level (rs_workshop_t *workshop, int level)
+{
+  rs_task_t *task;
+
+  task = workshop->first[level];
+  if (task != NULL)
+    {
+      if (workshop->first[level] == workshop->last[level])
+	{
+	  /* This is the last task in the queue.  */
+	  workshop->first[level] = NULL;
+	  workshop->last[level] = NULL;
+	}
+      else
+	{
+	  /* Two or more tasks.  */
+	  workshop->last[level]->link = workshop->first[level] = task->link;
+	}
+
+      atomic_fetch_sub (&workshop->injected[level], 1);
+    }
+
+  return task;
+}
+
+/* Create a lock-free queue with at least SIZE elements.  */
+static rs_ring_t *
+make_ring (size_t size)
+{
+  rs_ring_t *ring;
+  size_t n, k;
+
+  for (n = 2; n < size; n *= 2)
+    {
+      if (n > (size_t) -1 / 2 / sizeof (rs_cell_t))
+	{
+	  errno = EINVAL;
+	  return NULL;
+	}
+    }
+
+  ring = calloc (1, sizeof (rs_ring_t));
+  if (ring == NULL)
+    return NULL;
+
+  ring->cell = malloc (n * sizeof (rs_cell_t));
+  if (ring->cell == NULL)
+    {
+      free (ring);
+      return NULL;
+    }
+
+  ring->mask = n - 1;
+
+  for (k = 0; k < n; ++k)
+    atomic_init (&ring->cell[k].seq, k);
+
+  atomic_init (&ring->tail, 0);
+  atomic_init (&ring->head, 0);
+
+  return ring;
+}
+
+/* Add a work order to a lock-free queue.  Return value is zero on
+   success or -1 if the queue is full.  */
+static int
+ring_push (rs_ring_t *ring, rs_task_t *task)
+{
+  rs_cell_t *cell;
+  size_t pos, seq;
+
+  pos = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+  while (1)
+    {
+      cell = ring->cell + (pos & ring->mask);
+      seq = atomic_load_explicit (&cell->seq, memory_order_acquire);
+
+      if (seq == pos)
+	{
+	  /* Claim the cell.  */
+	  if (atomic_compare_exchange_weak_explicit (&ring->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+	    break;
+	}
+      else if ((ptrdiff_t) (seq - pos) < 0)
+	{
+	  /* The cell still holds a work order from the previous
+	     round, i.e. the queue is full.  */
+	  return -1;
+	}
+      else
+	{
+	  /* Another producer claimed the cell.  */
+	  pos = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+	}
+    }
+
+  cell->task = task;
+  atomic_store_explicit (&cell->seq, pos + 1, memory_order_release);
+
+  return 0;
+}
+
+/* Remove a work order from a lock-free queue.  Return value is
+   a null pointer if the queue is empty.  */
+static rs_task_t *
+ring_pop (rs_ring_t *ring)
+{
+  rs_cell_t *cell;
+  rs_task_t *task;
+  size_t pos, seq;
+
+  pos = atomic_load_explicit (&ring->head, memory_order_relaxed);
+  while (1)
+    {
+      cell = ring->cell + (pos & ring->mask);
+      seq = atomic_load_explicit (&cell->seq, memory_order_acquire);
+
+      if (seq == pos + 1)
+	{
+	  /* Claim the cell.  */
+	  if (atomic_compare_exchange_weak_explicit (&ring->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+	    break;
+	}
+      else if ((ptrdiff_t) (seq - (pos + 1)) < 0)
+	{
+	  /* The queue is empty.  */
+	  return NULL;
+	}
+      else
+	{
+	  /* Another consumer claimed the cell.  */
+	  pos = atomic_load_explicit (&ring->head, memory_order_relaxed);
+	}
+    }
+
+  task = cell->task;
+  atomic_store_explicit (&cell->seq, pos + ring->mask + 1, memory_order_release);
+
   return task;
 }
 
@@ -391,21 +4086,20 @@ finish (rs_workshop_t *workshop, int shutdown)
 {
   assert (pthread_mutex_lock (workshop->pool_lock) == 0);
 
-  if (! (workshop->waiting || workshop->closing))
+  if (! workshop->closing)
     {
       /* Close the queue.  */
-      workshop->waiting = 1;
+      atomic_fetch_add (&workshop->waiting, 1);
 
-      /* Wait until all workers take a break.  */
-      while (workshop->first != NULL || workshop->workers != workshop->idle)
+      /* Wait until all workers take a break.  Waiting workers are
+	 not idle.  */
+      while (atomic_load (&workshop->queued) != 0 || atomic_load (&workshop->idle) != workshop->workers)
 	assert (pthread_cond_wait (workshop->idle_cond, workshop->pool_lock) == 0);
 
-      if (! shutdown)
-	{
-	  /* Reopen the queue.  */
-	  workshop->waiting = 0;
-	}
-      else
+      /* Reopen the queue.  */
+      atomic_fetch_sub (&workshop->waiting, 1);
+
+      if (shutdown)
 	{
 	  /* Close the shop.  */
 	  workshop->closing = 1;
@@ -427,15 +4121,19 @@ shutdown (rs_workshop_t *workshop)
   assert (pthread_cond_broadcast (workshop->work_cond) == 0);
 
   /* Wait for workers to leave the shop.  */
-  for (k = 0; k < workshop->workers; ++k)
-    assert (pthread_join (workshop->worker[k], NULL) == 0);
+  for (k = 0; k < workshop->slots; ++k)
+    {
+      rs_worker_t *worker = workshop->worker + k;
 
-  if (workshop->worker != NULL)
-    free (workshop->worker);
+      if (worker->state != VACANT)
+	{
+	  assert (pthread_join (worker->thread, NULL) == 0);
+	  worker->state = VACANT;
+	}
+    }
 
-  workshop->worker = NULL;
-  workshop->workers = 0;
-  workshop->idle = 0;
+  atomic_store (&workshop->workers, 0);
+  atomic_store (&workshop->idle, 0);
 }
 
 /*
@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <malloc.h>
 /* Use the new thread pool API.  */
 #if defined (_WIN32_WINNT) && (_WIN32_WINNT < 0x0600)
 #undef _WIN32_WINNT
@@ -52,39 +53,281 @@
 
 /* Forward declarations.  */
 typedef struct rs_task rs_task_t;
+typedef struct rs_range rs_range_t;
 
 static void worker (TP_CALLBACK_INSTANCE *instance, void *context);
+static void run_range (void *range);
+static int loop (rs_workshop_t *workshop, size_t begin, size_t end, size_t grain, void (*fun) (size_t, size_t, void *), void (*reduce) (size_t, size_t, void *, void *), void (*combine) (void *, void const *, void *), void *result, size_t size, void *arg);
+static int submit (rs_workshop_t *workshop, rs_workshop_group_t *group, int priority, void (*fun) (void *), void *arg);
+static void expire (TP_CALLBACK_INSTANCE *instance, void *context, TP_TIMER *tp_timer);
+static rs_workshop_timer_t *make_timer (rs_workshop_t *workshop, double seconds, double interval, void (*fun) (void *), void *arg);
+static int unlink_timer (rs_workshop_timer_t *timer);
+static void close_timer (rs_workshop_timer_t *timer);
+static void run_future (void *future);
+static void ready_node (rs_workshop_node_t *node);
+static void run_node (void *node);
+static void process (rs_workshop_t *workshop, rs_workshop_group_t *group, void (*fun) (void *), void *arg);
+static void count_queued (rs_workshop_t *workshop);
+static rs_task_t *alloc_task (rs_workshop_t *workshop);
+static void free_task (rs_task_t *task, rs_workshop_t *workshop);
+
+/* Task group of the work order the calling thread is processing,
+   or a null pointer.  */
+static __declspec (thread) rs_workshop_group_t *current_group;
 
 /* Thread pool.  */
 struct rs_workshop
   {
     TP_POOL *pool;
     TP_CLEANUP_GROUP *group;
-    TP_CALLBACK_ENVIRON env[1];
+
+    /* Call-back environments, one for each priority.  Indexed by
+       the priority minus ‘RS_WORKSHOP_PRIORITY_LOW’.  */
+    TP_CALLBACK_ENVIRON env[3];
+
+    /* Call-back environment for timers.  Timers are not members of
+       the cleanup group.  Otherwise, ‘rs_workshop_wait’ would close
+       them.  */
+    TP_CALLBACK_ENVIRON timer_env[1];
+
+    /* Pending timers, a doubly linked list.  */
+    CRITICAL_SECTION timer_lock[1];
+    rs_workshop_timer_t *timers;
+
+    /* Free envelopes, a lock-free LIFO queue.  */
+    SLIST_HEADER store[1];
+
+    /* Number of allocated envelopes.  */
+    LONG volatile envelopes;
+
+    /* Free futures, a lock-free LIFO queue.  */
+    SLIST_HEADER futures[1];
+
+    /* Number of placed, queued, and processed work orders, and
+       the maximum number of queued work orders.  */
+    LONG64 volatile submitted;
+    LONG64 volatile queued;
+    LONG64 volatile completed;
+    LONG64 volatile peak;
+
+    /* Maximum number of workers for ‘rs_workshop_resize’.  */
+    int slots;
+
+    /* Maximum number of workers.  */
+    int workers;
+
+    /* Minimum number of workers.  */
+    int min_workers;
   };
 
 /* Envelope for a work order.  */
 struct rs_task
   {
+    /* A linked list of free envelopes.  Must be the first member.  */
+    SLIST_ENTRY link;
+
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* The call-back function.  */
+    void (*fun) (void *);
+
+    /* Function argument.  */
+    void *arg;
+
+    /* The task group, or a null pointer.  */
+    rs_workshop_group_t *group;
+  };
+
+/* Sub-range of a parallel loop.  */
+struct rs_range
+  {
+    /* First and one past the last index.  */
+    size_t begin;
+    size_t end;
+
+    /* The call-back functions.  Either FUN or REDUCE is non-null.  */
+    void (*fun) (size_t, size_t, void *);
+    void (*reduce) (size_t, size_t, void *, void *);
+
+    /* Function argument.  */
+    void *arg;
+
+    /* The accumulator of a parallel reduction.  */
+    void *acc;
+  };
+
+/* Task group.  */
+struct rs_workshop_group
+  {
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* Synchronize access to the group data.  */
+    CRITICAL_SECTION lock[1];
+
+    /* Signaled if the last work order of the group is done.  */
+    CONDITION_VARIABLE done[1];
+
+    /* Number of pending work orders.  */
+    size_t pending;
+
+    /* Priority of the work orders.  */
+    int priority;
+
+    /* Non-zero means that the work orders are cancelled.  */
+    LONG volatile cancelled;
+  };
+
+/* Timer.  */
+struct rs_workshop_timer
+  {
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* The system timer object.  */
+    TP_TIMER *timer;
+
+    /* A doubly linked list.  Only accessed while holding the timer
+       lock of the thread pool.  */
+    rs_workshop_timer_t *prev;
+    rs_workshop_timer_t *next;
+
+    /* Non-zero means that the timer is a member of the list of
+       pending timers.  Only accessed while holding the timer lock
+       of the thread pool.  */
+    int linked;
+
+    /* Non-zero means that the timer expires periodically.  */
+    int periodic;
+
+    /* The call-back function.  */
+    void (*fun) (void *);
+
+    /* Function argument.  */
+    void *arg;
+  };
+
+/* Future.  */
+struct rs_workshop_future
+  {
+    /* A linked list of free futures.  Must be the first member.  */
+    SLIST_ENTRY link;
+
+    /* The thread pool.  */
+    rs_workshop_t *workshop;
+
+    /* The task group of the future.  The work order is the only
+       member of the task group.  */
+    rs_workshop_group_t *group;
+
+    /* The call-back function.  */
+    void *(*fun) (void *);
+
+    /* Function argument.  */
+    void *arg;
+
+    /* Return value of the call-back function.  */
+    void *result;
+  };
+
+/* Task graph.  */
+struct rs_workshop_graph
+  {
+    /* The task group of the graph.  Nodes become members of the
+       task group when they are ready to run.  */
+    rs_workshop_group_t *group;
+
+    /* Synchronize access to the successors of the nodes.  */
+    CRITICAL_SECTION lock[1];
+
+    /* List of all nodes.  */
+    rs_workshop_node_t *node;
+  };
+
+/* Node of a task graph.  */
+struct rs_workshop_node
+  {
+    /* The task graph.  */
+    rs_workshop_graph_t *graph;
+
+    /* A linked list.  */
+    rs_workshop_node_t *link;
+
     /* The call-back function.  */
     void (*fun) (void *);
 
     /* Function argument.  */
     void *arg;
+
+    /* Number of unfinished predecessors.  Plus one while the node
+       is added to the graph.  */
+    LONG volatile deps;
+
+    /* Successors of the node.  Only accessed while holding the lock
+       of the graph until the node is done.  */
+    rs_workshop_node_t **succ;
+    size_t succ_count;
+    size_t succ_size;
+
+    /* Non-zero means that the call-back function has returned.  */
+    unsigned int done:1;
   };
 
 /* Open a workshop.  */
 rs_workshop_t *
 rs_workshop_open (int workers)
+{
+  rs_workshop_options_t options[1];
+
+  rs_workshop_options_init (options);
+  options->workers = workers;
+
+  return rs_workshop_open_ext (options);
+}
+
+/* Initialize workshop options.  */
+void
+rs_workshop_options_init (rs_workshop_options_t *options)
+{
+  memset (options, 0, sizeof (rs_workshop_options_t));
+
+  options->workers = 0;
+  options->ring_size = 0;
+  options->spin = -1;
+  options->yield = 0;
+  options->cpus = NULL;
+  options->cpu_count = 0;
+  options->numa = 0;
+  options->capacity = 0;
+  options->block = 0;
+  options->timing = 0;
+  options->min_workers = 1;
+  options->idle_timeout = 0.0;
+  options->max_workers = 0;
+  options->worker_init = NULL;
+  options->worker_exit = NULL;
+  options->worker_arg = NULL;
+}
+
+/* Open a workshop with options.  */
+rs_workshop_t *
+rs_workshop_open_ext (rs_workshop_options_t const *options)
 {
   rs_workshop_t *workshop;
+  int workers, k;
 
-  if (workers < 0)
+  if (options == NULL || options->workers < 0 || options->max_workers < 0
+      || ! (options->idle_timeout >= 0.0)
+      || (options->idle_timeout > 0.0 && options->workers > 0
+	  && (options->min_workers < 1 || options->min_workers > options->workers)))
     {
       errno = EINVAL;
       return NULL;
     }
 
+  workers = options->workers;
+
   workshop = calloc (1, sizeof (rs_workshop_t));
   if (workshop == NULL)
     return NULL;
@@ -92,7 +335,26 @@ rs_workshop_open (int workers)
   workshop->pool = NULL;
   workshop->group = NULL;
 
-  InitializeThreadpoolEnvironment (workshop->env);
+  InitializeSListHead (workshop->store);
+  InitializeSListHead (workshop->futures);
+  workshop->envelopes = 0;
+  workshop->submitted = 0;
+  workshop->queued = 0;
+  workshop->completed = 0;
+  workshop->peak = 0;
+  workshop->slots = (workers > 0 && options->max_workers > workers ? options->max_workers : workers);
+  workshop->workers = workers;
+
+  /* The system thread pool retires idle threads on its own.  Thus,
+     auto-scaling only means to keep fewer threads alive.  */
+  workshop->min_workers = (options->idle_timeout > 0.0 ? options->min_workers : 1);
+
+  for (k = 0; k < 3; ++k)
+    InitializeThreadpoolEnvironment (workshop->env + k);
+
+  InitializeThreadpoolEnvironment (workshop->timer_env);
+  InitializeCriticalSection (workshop->timer_lock);
+  workshop->timers = NULL;
 
   if (workers > 0)
     {
@@ -103,7 +365,7 @@ rs_workshop_open (int workers)
 	  goto failure;
 	}
 
-      if (SetThreadpoolThreadMinimum (workshop->pool, 1) == FALSE)
+      if (SetThreadpoolThreadMinimum (workshop->pool, workshop->min_workers) == FALSE)
 	{
 	  errno = EAGAIN;
 	  goto failure;
@@ -118,11 +380,21 @@ rs_workshop_open (int workers)
 	  goto failure;
 	}
 
-      /* Define the thread pool to be used when creating a call-back.  */
-      SetThreadpoolCallbackPool (workshop->env, workshop->pool);
+      for (k = 0; k < 3; ++k)
+	{
+	  /* Define the thread pool to be used when creating a call-back.  */
+	  SetThreadpoolCallbackPool (workshop->env + k, workshop->pool);
+
+	  /* Define the cleanup group to be used when creating a call-back.  */
+	  SetThreadpoolCallbackCleanupGroup (workshop->env + k, workshop->group, NULL);
+	}
+
+      SetThreadpoolCallbackPool (workshop->timer_env, workshop->pool);
 
-      /* Define the cleanup group to be used when creating a call-back.  */
-      SetThreadpoolCallbackCleanupGroup (workshop->env, workshop->group, NULL);
+      /* The system thread pool avoids starvation of call-backs
+	 with a lower priority.  */
+      SetThreadpoolCallbackPriority (workshop->env + 0, TP_CALLBACK_PRIORITY_LOW);
+      SetThreadpoolCallbackPriority (workshop->env + 2, TP_CALLBACK_PRIORITY_HIGH);
     }
 
   return workshop;
@@ -135,7 +407,11 @@ rs_workshop_open (int workers)
   if (workshop->pool != NULL)
     CloseThreadpool (workshop->pool);
 
-  DestroyThreadpoolEnvironment (workshop->env);
+  for (k = 0; k < 3; ++k)
+    DestroyThreadpoolEnvironment (workshop->env + k);
+
+  DestroyThreadpoolEnvironment (workshop->timer_env);
+  DeleteCriticalSection (workshop->timer_lock);
 
   return NULL;
 }
@@ -144,90 +420,1292 @@ rs_workshop_open (int workers)
 int
 rs_workshop_order (rs_workshop_t *workshop, void (*fun) (void *), void *arg)
 {
-  rs_task_t *task;
-
   if (workshop == NULL || fun == NULL)
     {
       errno = EINVAL;
       return -1;
     }
 
+  return submit (workshop, NULL, RS_WORKSHOP_PRIORITY_NORMAL, fun, arg);
+}
+
+/* Place a work order with a priority.  */
+int
+rs_workshop_order_priority (rs_workshop_t *workshop, int priority, void (*fun) (void *), void *arg)
+{
+  if (workshop == NULL || fun == NULL
+      || priority < RS_WORKSHOP_PRIORITY_LOW
+      || priority > RS_WORKSHOP_PRIORITY_HIGH)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return submit (workshop, NULL, priority, fun, arg);
+}
+
+/* Place multiple work orders at once.  */
+int
+rs_workshop_order_batch (rs_workshop_t *workshop, rs_work_order_t const *orders, size_t count)
+{
+  rs_task_t *first, *task;
+  size_t k;
+
+  if (workshop == NULL || (orders == NULL && count > 0))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  for (k = 0; k < count; ++k)
+    {
+      if (orders[k].fun == NULL)
+	{
+	  errno = EINVAL;
+	  return -1;
+	}
+    }
+
   if (workshop->pool == NULL)
     {
-      fun (arg);
+      for (k = 0; k < count; ++k)
+	process (workshop, NULL, orders[k].fun, orders[k].arg);
+
       return 0;
     }
 
-  /* Put work order in an envelope.  */
-  task = calloc (1, sizeof (rs_task_t));
-  if (task == NULL)
-    return -1;
+  /* Put the work orders in envelopes before submitting the first
+     one.  The envelopes are temporarily linked by the ‘arg’ member
+     in reverse order.  */
+  first = NULL;
+  for (k = count; k > 0; --k)
+    {
+      task = alloc_task (workshop);
+      if (task == NULL)
+	goto failure;
 
-  task->fun = fun;
-  task->arg = arg;
+      task->fun = orders[k - 1].fun;
+      task->arg = first;
+      task->group = NULL;
 
-  if (TrySubmitThreadpoolCallback (worker, task, workshop->env) == TRUE)
-    return 0;
+      first = task;
+    }
 
-  /* Cleanup.  */
-  free (task);
+  for (k = 0; first != NULL; ++k)
+    {
+      task = first;
+      first = task->arg;
+
+      task->arg = orders[k].arg;
+
+      /* Account for the work order like ‘submit’ does.  The worker
+	 decrements the number of queued work orders.  */
+      InterlockedIncrement64 (&workshop->submitted);
+      count_queued (workshop);
+
+      if (TrySubmitThreadpoolCallback (worker, task, workshop->env + 1) == FALSE)
+	{
+	  InterlockedDecrement64 (&workshop->submitted);
+	  InterlockedDecrement64 (&workshop->queued);
+
+	  free_task (task, workshop);
+
+	  if (k == 0)
+	    {
+	      errno = ENOMEM;
+	      goto failure;
+	    }
+
+	  /* The thread pool does not allow to revoke the work orders
+	     submitted so far.  Thus, process the remaining work orders
+	     in the calling thread.  */
+	  while (first != NULL)
+	    {
+	      task = first;
+	      first = task->arg;
+
+	      free_task (task, workshop);
+	    }
+
+	  for (; k < count; ++k)
+	    process (workshop, NULL, orders[k].fun, orders[k].arg);
+
+	  break;
+	}
+    }
+
+  return 0;
+
+ failure:
+
+  while (first != NULL)
+    {
+      task = first;
+      first = task->arg;
+
+      free_task (task, workshop);
+    }
 
-  errno = ENOMEM;
   return -1;
 }
 
-/* Wait until all work orders are processed.  */
-int
-rs_workshop_wait (rs_workshop_t *workshop)
+/* Create a task group.  */
+rs_workshop_group_t *
+rs_workshop_group_new (rs_workshop_t *workshop)
 {
+  rs_workshop_group_t *group;
+
   if (workshop == NULL)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  group = calloc (1, sizeof (rs_workshop_group_t));
+  if (group == NULL)
+    return NULL;
+
+  group->workshop = workshop;
+
+  InitializeCriticalSection (group->lock);
+  InitializeConditionVariable (group->done);
+
+  group->pending = 0;
+  group->priority = RS_WORKSHOP_PRIORITY_NORMAL;
+  group->cancelled = 0;
+
+  return group;
+}
+
+/* Set the priority of the work orders of a task group.  */
+int
+rs_workshop_group_set_priority (rs_workshop_group_t *group, int priority)
+{
+  if (group == NULL
+      || priority < RS_WORKSHOP_PRIORITY_LOW
+      || priority > RS_WORKSHOP_PRIORITY_HIGH)
     {
       errno = EINVAL;
       return -1;
     }
 
-  if (workshop->pool != NULL)
-    CloseThreadpoolCleanupGroupMembers (workshop->group, FALSE, NULL);
+  group->priority = priority;
 
   return 0;
 }
 
-/* Close a workshop.  */
+/* Destroy a task group.  */
 int
-rs_workshop_close (rs_workshop_t *workshop)
+rs_workshop_group_delete (rs_workshop_group_t *group)
 {
-  if (workshop != NULL)
+  if (group != NULL)
     {
-      if (workshop->pool != NULL)
+      rs_workshop_group_wait (group);
+
+      DeleteCriticalSection (group->lock);
+
+      free (group);
+    }
+
+  return 0;
+}
+
+/* Place a work order as a member of a task group.  */
+int
+rs_workshop_group_order (rs_workshop_group_t *group, void (*fun) (void *), void *arg)
+{
+  if (group == NULL || fun == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return submit (group->workshop, group, group->priority, fun, arg);
+}
+
+/* Place multiple work orders as members of a task group.  */
+int
+rs_workshop_group_order_batch (rs_workshop_group_t *group, rs_work_order_t const *orders, size_t count)
+{
+  size_t k;
+
+  if (group == NULL || (orders == NULL && count > 0))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  for (k = 0; k < count; ++k)
+    {
+      if (orders[k].fun == NULL)
 	{
-	  CloseThreadpoolCleanupGroupMembers (workshop->group, FALSE, NULL);
-	  CloseThreadpoolCleanupGroup (workshop->group);
-	  CloseThreadpool (workshop->pool);
+	  errno = EINVAL;
+	  return -1;
 	}
+    }
 
-      free (workshop);
+  /* Work orders can not be revoked, see above.  */
+  for (k = 0; k < count; ++k)
+    {
+      if (submit (group->workshop, group, group->priority, orders[k].fun, orders[k].arg) != 0)
+	{
+	  if (k == 0)
+	    return -1;
+
+	  for (; k < count; ++k)
+	    process (group->workshop, group, orders[k].fun, orders[k].arg);
+
+	  break;
+	}
     }
 
   return 0;
 }
 
-/* Process a work order.  */
-static void
-worker (TP_CALLBACK_INSTANCE *instance, void *task)
+/* Wait until all work orders of a task group are processed.  */
+int
+rs_workshop_group_wait (rs_workshop_group_t *group)
 {
-  rs_task_t job[1];
+  if (group == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
 
-  /* Not used.  */
-  (void) instance;
+  EnterCriticalSection (group->lock);
 
-  /* Unpack work order.  */
-  memcpy (job, task, sizeof (rs_task_t));
+  while (group->pending != 0)
+    SleepConditionVariableCS (group->done, group->lock, INFINITE);
 
-  /* Throw away the envelope.  */
-  free (task);
+  LeaveCriticalSection (group->lock);
 
-  /* Start working.  */
-  job->fun (job->arg);
+  return 0;
+}
+
+/* Cancel the work orders of a task group.  */
+int
+rs_workshop_group_cancel (rs_workshop_group_t *group)
+{
+  if (group == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  InterlockedExchange (&group->cancelled, 1);
+
+  return 0;
+}
+
+/* Return non-zero if a task group is cancelled.  */
+int
+rs_workshop_group_cancelled (rs_workshop_group_t *group)
+{
+  if (group == NULL)
+    return 0;
+
+  return (group->cancelled != 0);
+}
+
+/* Return non-zero if the current work order is cancelled.  */
+int
+rs_workshop_cancelled (rs_workshop_t *workshop)
+{
+  rs_workshop_group_t *group = current_group;
+
+  if (workshop == NULL || group == NULL || group->workshop != workshop)
+    return 0;
+
+  return (group->cancelled != 0);
+}
+
+/* Wait until all work orders are processed.  */
+int
+rs_workshop_wait (rs_workshop_t *workshop)
+{
+  if (workshop == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (workshop->pool != NULL)
+    CloseThreadpoolCleanupGroupMembers (workshop->group, FALSE, NULL);
+
+  return 0;
+}
+
+/* Place a work order at a certain time.  */
+int
+rs_workshop_order_at (rs_workshop_t *workshop, struct timespec const *abstime, void (*fun) (void *), void *arg)
+{
+  struct timespec ts;
+  double delay;
+
+  if (workshop == NULL || abstime == NULL || fun == NULL
+      || abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000L)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  /* Convert the absolute time into a delay.  */
+  timespec_get (&ts, TIME_UTC);
+
+  delay = (double) (abstime->tv_sec - ts.tv_sec) + (double) (abstime->tv_nsec - ts.tv_nsec) / 1.0E9;
+
+  return rs_workshop_order_after (workshop, delay, fun, arg);
+}
+
+/* Place a work order after a delay.  */
+int
+rs_workshop_order_after (rs_workshop_t *workshop, double seconds, void (*fun) (void *), void *arg)
+{
+  if (workshop == NULL || fun == NULL || seconds != seconds)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (make_timer (workshop, seconds, 0.0, fun, arg) == NULL)
+    return -1;
+
+  return 0;
+}
+
+/* Place a work order periodically.  */
+rs_workshop_timer_t *
+rs_workshop_order_every (rs_workshop_t *workshop, double interval, void (*fun) (void *), void *arg)
+{
+  if (workshop == NULL || fun == NULL || ! (interval > 0.0))
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  return make_timer (workshop, interval, interval, fun, arg);
+}
+
+/* Cancel a periodic work order.  */
+int
+rs_workshop_timer_cancel (rs_workshop_timer_t *timer)
+{
+  if (timer != NULL)
+    {
+      unlink_timer (timer);
+      close_timer (timer);
+    }
+
+  return 0;
+}
+
+/* Place a work order with a future.  */
+rs_workshop_future_t *
+rs_workshop_order_future (rs_workshop_t *workshop, void *(*fun) (void *), void *arg)
+{
+  rs_workshop_future_t *future;
+
+  if (workshop == NULL || fun == NULL)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  future = (rs_workshop_future_t *) InterlockedPopEntrySList (workshop->futures);
+  if (future == NULL)
+    {
+      /* Entries of a singly linked list have to be aligned.  */
+      future = _aligned_malloc (sizeof (rs_workshop_future_t), MEMORY_ALLOCATION_ALIGNMENT);
+      if (future == NULL)
+	{
+	  errno = ENOMEM;
+	  return NULL;
+	}
+
+      future->workshop = workshop;
+
+      future->group = rs_workshop_group_new (workshop);
+      if (future->group == NULL)
+	{
+	  _aligned_free (future);
+	  return NULL;
+	}
+    }
+
+  future->fun = fun;
+  future->arg = arg;
+  future->result = NULL;
+
+  future->group->cancelled = 0;
+
+  if (submit (workshop, future->group, RS_WORKSHOP_PRIORITY_NORMAL, run_future, future) != 0)
+    {
+      InterlockedPushEntrySList (workshop->futures, &future->link);
+      return NULL;
+    }
+
+  return future;
+}
+
+/* Wait until the work order of a future is processed.  */
+int
+rs_workshop_future_wait (rs_workshop_future_t *future)
+{
+  if (future == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return rs_workshop_group_wait (future->group);
+}
+
+/* Check if the work order of a future is processed.  */
+int
+rs_workshop_future_try_wait (rs_workshop_future_t *future)
+{
+  size_t pending;
+
+  if (future == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  EnterCriticalSection (future->group->lock);
+  pending = future->group->pending;
+  LeaveCriticalSection (future->group->lock);
+
+  if (pending != 0)
+    {
+      errno = EAGAIN;
+      return -1;
+    }
+
+  return 0;
+}
+
+/* Return the result of a future.  */
+void *
+rs_workshop_future_result (rs_workshop_future_t *future)
+{
+  if (future == NULL)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  rs_workshop_group_wait (future->group);
+
+  return future->result;
+}
+
+/* Cancel the work order of a future.  */
+int
+rs_workshop_future_cancel (rs_workshop_future_t *future)
+{
+  if (future == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return rs_workshop_group_cancel (future->group);
+}
+
+/* Release a future.  */
+int
+rs_workshop_future_release (rs_workshop_future_t *future)
+{
+  if (future != NULL)
+    {
+      rs_workshop_group_wait (future->group);
+
+      InterlockedPushEntrySList (future->workshop->futures, &future->link);
+    }
+
+  return 0;
+}
+
+/* Create a task graph.  */
+rs_workshop_graph_t *
+rs_workshop_graph_new (rs_workshop_t *workshop)
+{
+  rs_workshop_graph_t *graph;
+
+  if (workshop == NULL)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  graph = calloc (1, sizeof (rs_workshop_graph_t));
+  if (graph == NULL)
+    return NULL;
+
+  graph->group = rs_workshop_group_new (workshop);
+  if (graph->group == NULL)
+    {
+      free (graph);
+      return NULL;
+    }
+
+  InitializeCriticalSection (graph->lock);
+
+  graph->node = NULL;
+
+  return graph;
+}
+
+/* Destroy a task graph.  */
+int
+rs_workshop_graph_delete (rs_workshop_graph_t *graph)
+{
+  if (graph != NULL)
+    {
+      rs_workshop_group_delete (graph->group);
+
+      while (graph->node != NULL)
+	{
+	  rs_workshop_node_t *node = graph->node;
+
+	  graph->node = node->link;
+
+	  if (node->succ != NULL)
+	    free (node->succ);
+
+	  free (node);
+	}
+
+      DeleteCriticalSection (graph->lock);
+
+      free (graph);
+    }
+
+  return 0;
+}
+
+/* Add a node to a task graph.  */
+rs_workshop_node_t *
+rs_workshop_graph_node (rs_workshop_graph_t *graph, void (*fun) (void *), void *arg, rs_workshop_node_t *const *preds, size_t count)
+{
+  rs_workshop_node_t *node, *pred;
+  size_t k;
+
+  if (graph == NULL || fun == NULL || (preds == NULL && count > 0))
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  for (k = 0; k < count; ++k)
+    {
+      if (preds[k] == NULL || preds[k]->graph != graph)
+	{
+	  errno = EINVAL;
+	  return NULL;
+	}
+    }
+
+  node = calloc (1, sizeof (rs_workshop_node_t));
+  if (node == NULL)
+    return NULL;
+
+  node->graph = graph;
+  node->fun = fun;
+  node->arg = arg;
+
+  /* The node must not run before all predecessors are known.  */
+  node->deps = 1;
+
+  EnterCriticalSection (graph->lock);
+
+  /* Make room for the new successor first.  */
+  for (k = 0; k < count; ++k)
+    {
+      pred = preds[k];
+      if (pred->done || pred->succ_count + count <= pred->succ_size)
+	continue;
+
+      {
+	rs_workshop_node_t **succ;
+	size_t size;
+
+	size = 2 * pred->succ_size;
+	if (size < pred->succ_count + count)
+	  size = pred->succ_count + count;
+	if (size < 4)
+	  size = 4;
+
+	succ = realloc (pred->succ, size * sizeof (rs_workshop_node_t *));
+	if (succ == NULL)
+	  {
+	    LeaveCriticalSection (graph->lock);
+
+	    free (node);
+	    return NULL;
+	  }
+
+	pred->succ = succ;
+	pred->succ_size = size;
+      }
+    }
+
+  /* Link the node to its unfinished predecessors.  */
+  for (k = 0; k < count; ++k)
+    {
+      pred = preds[k];
+      if (pred->done)
+	continue;
+
+      pred->succ[pred->succ_count++] = node;
+
+      InterlockedIncrement (&node->deps);
+    }
+
+  node->link = graph->node;
+  graph->node = node;
+
+  LeaveCriticalSection (graph->lock);
+
+  if (InterlockedDecrement (&node->deps) == 0)
+    ready_node (node);
+
+  return node;
+}
+
+/* Wait until all nodes of a task graph are processed.  */
+int
+rs_workshop_graph_wait (rs_workshop_graph_t *graph)
+{
+  if (graph == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return rs_workshop_group_wait (graph->group);
+}
+
+/* Process a range of indices in parallel.  */
+int
+rs_workshop_for (rs_workshop_t *workshop, size_t begin, size_t end, size_t grain, void (*fun) (size_t, size_t, void *), void *arg)
+{
+  if (workshop == NULL || fun == NULL || begin > end)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return loop (workshop, begin, end, grain, fun, NULL, NULL, NULL, 0, arg);
+}
+
+/* Reduce a range of indices in parallel.  */
+int
+rs_workshop_reduce (rs_workshop_t *workshop, size_t begin, size_t end, size_t grain, void (*fun) (size_t, size_t, void *, void *), void (*combine) (void *, void const *, void *), void *result, size_t size, void *arg)
+{
+  if (workshop == NULL || fun == NULL || combine == NULL || result == NULL || size == 0 || begin > end)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return loop (workshop, begin, end, grain, NULL, fun, combine, result, size, arg);
+}
+
+/* Return the index of the calling worker.  */
+int
+rs_workshop_worker_id (rs_workshop_t *workshop)
+{
+  (void) workshop;
+
+  /* The system thread pool does not reveal its threads.  */
+  return -1;
+}
+
+/* Return the data of the calling worker.  */
+void *
+rs_workshop_worker_data (rs_workshop_t *workshop)
+{
+  (void) workshop;
+
+  return NULL;
+}
+
+/* Query statistics.  */
+int
+rs_workshop_stats (rs_workshop_t *workshop, rs_workshop_stats_t *stats)
+{
+  if (workshop == NULL || stats == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  memset (stats, 0, sizeof (rs_workshop_stats_t));
+
+  /* Envelopes are allocated one by one.  */
+  stats->envelopes = (size_t) workshop->envelopes;
+  stats->slabs = stats->envelopes;
+
+  stats->queued = (size_t) workshop->queued;
+  stats->peak_queued = (size_t) workshop->peak;
+
+  stats->total.submitted = (size_t) workshop->submitted;
+  stats->total.completed = (size_t) workshop->completed;
+
+  return 0;
+}
+
+/* Query statistics of a worker.  */
+int
+rs_workshop_worker_stats (rs_workshop_t *workshop, int index, rs_workshop_worker_stats_t *stats)
+{
+  (void) index;
+
+  if (workshop == NULL || stats == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  /* The system thread pool does not reveal its threads.  */
+  errno = ENOSYS;
+  return -1;
+}
+
+/* Change the number of workers.  */
+int
+rs_workshop_resize (rs_workshop_t *workshop, int workers)
+{
+  if (workshop == NULL || workers < 1 || workers > workshop->slots)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  SetThreadpoolThreadMaximum (workshop->pool, workers);
+
+  /* The minimum must not exceed the maximum.  */
+  if (SetThreadpoolThreadMinimum (workshop->pool, (workshop->min_workers < workers ? workshop->min_workers : workers)) == FALSE)
+    {
+      errno = EAGAIN;
+      return -1;
+    }
+
+  workshop->workers = workers;
+
+  return 0;
+}
+
+/* Close a workshop.  */
+int
+rs_workshop_close (rs_workshop_t *workshop)
+{
+  if (workshop != NULL)
+    {
+      SLIST_ENTRY *entry;
+
+      if (workshop->pool != NULL)
+	{
+	  rs_workshop_timer_t *first, *timer;
+
+	  /* Discard pending timers.  Each timer is closed by exactly
+	     one thread, see ‘expire’.  */
+	  EnterCriticalSection (workshop->timer_lock);
+
+	  first = workshop->timers;
+	  workshop->timers = NULL;
+
+	  for (timer = first; timer != NULL; timer = timer->next)
+	    timer->linked = 0;
+
+	  LeaveCriticalSection (workshop->timer_lock);
+
+	  timer = first;
+	  while (timer != NULL)
+	    {
+	      rs_workshop_timer_t *next = timer->next;
+
+	      close_timer (timer);
+	      timer = next;
+	    }
+
+	  CloseThreadpoolCleanupGroupMembers (workshop->group, FALSE, NULL);
+	  CloseThreadpoolCleanupGroup (workshop->group);
+	  CloseThreadpool (workshop->pool);
+	}
+
+      DestroyThreadpoolEnvironment (workshop->timer_env);
+      DeleteCriticalSection (workshop->timer_lock);
+
+      /* Release the futures.  */
+      entry = InterlockedFlushSList (workshop->futures);
+      while (entry != NULL)
+	{
+	  SLIST_ENTRY *next = entry->Next;
+
+	  rs_workshop_group_delete (((rs_workshop_future_t *) entry)->group);
+
+	  _aligned_free (entry);
+	  entry = next;
+	}
+
+      /* Release the envelopes.  */
+      entry = InterlockedFlushSList (workshop->store);
+      while (entry != NULL)
+	{
+	  SLIST_ENTRY *next = entry->Next;
+
+	  _aligned_free (entry);
+	  entry = next;
+	}
+
+      free (workshop);
+    }
+
+  return 0;
+}
+
+/* Process a work order.  */
+static void
+worker (TP_CALLBACK_INSTANCE *instance, void *task)
+{
+  rs_workshop_group_t *group;
+  rs_task_t job[1];
+
+  /* Not used.  */
+  (void) instance;
+
+  /* Unpack work order.  */
+  memcpy (job, task, sizeof (rs_task_t));
+
+  /* Recycle the envelope.  */
+  free_task (task, job->workshop);
+
+  InterlockedDecrement64 (&job->workshop->queued);
+
+  /* Start working.  */
+  group = current_group;
+  current_group = job->group;
+
+  /* Skip cancelled work orders.  */
+  if (job->group == NULL || job->group->cancelled == 0)
+    job->fun (job->arg);
+
+  current_group = group;
+
+  InterlockedIncrement64 (&job->workshop->completed);
+
+  if (job->group != NULL)
+    {
+      EnterCriticalSection (job->group->lock);
+
+      if (--job->group->pending == 0)
+	WakeAllConditionVariable (job->group->done);
+
+      LeaveCriticalSection (job->group->lock);
+    }
+}
+
+/* Process a sub-range of a parallel loop.  */
+static void
+run_range (void *range)
+{
+  rs_range_t *r = range;
+
+  if (r->reduce != NULL)
+    r->reduce (r->begin, r->end, r->acc, r->arg);
+  else
+    r->fun (r->begin, r->end, r->arg);
+}
+
+/* Common part of ‘rs_workshop_for’ and ‘rs_workshop_reduce’.
+
+   The native thread pool does not support work stealing.  Thus,
+   the range is split into a fixed number of sub-ranges up front and
+   every sub-range has its own accumulator.  */
+static int
+loop (rs_workshop_t *workshop, size_t begin, size_t end, size_t grain, void (*fun) (size_t, size_t, void *), void (*reduce) (size_t, size_t, void *, void *), void (*combine) (void *, void const *, void *), void *result, size_t size, void *arg)
+{
+  rs_workshop_group_t *group;
+  rs_range_t *range;
+  char *acc = NULL;
+  size_t n, k;
+  int retval = -1;
+
+  if (begin == end)
+    return 0;
+
+  if (workshop->pool == NULL)
+    {
+      if (reduce != NULL)
+	reduce (begin, end, result, arg);
+      else
+	fun (begin, end, arg);
+
+      return 0;
+    }
+
+  if (grain == 0)
+    {
+      grain = (end - begin) / (8 * ((size_t) workshop->workers + 1));
+      if (grain == 0)
+	grain = 1;
+    }
+
+  n = (end - begin) / grain + ((end - begin) % grain != 0);
+
+  range = calloc (n, sizeof (rs_range_t));
+  if (range == NULL)
+    return -1;
+
+  if (reduce != NULL)
+    {
+      acc = calloc (n, size);
+      if (acc == NULL)
+	goto cleanup;
+    }
+
+  group = rs_workshop_group_new (workshop);
+  if (group == NULL)
+    goto cleanup;
+
+  for (k = 0; k < n; ++k)
+    {
+      range[k].begin = begin + k * grain;
+      range[k].end = (k + 1 < n ? range[k].begin + grain : end);
+      range[k].fun = fun;
+      range[k].reduce = reduce;
+      range[k].arg = arg;
+
+      if (acc != NULL)
+	{
+	  range[k].acc = acc + k * size;
+
+	  /* Initialize the accumulator with the identity element.  */
+	  memcpy (range[k].acc, result, size);
+	}
+
+      if (rs_workshop_group_order (group, run_range, range + k) != 0)
+	run_range (range + k);
+    }
+
+  rs_workshop_group_delete (group);
+
+  /* Combine the partial results.  */
+  if (acc != NULL)
+    {
+      for (k = 0; k < n; ++k)
+	combine (result, range[k].acc, arg);
+    }
+
+  retval = 0;
+
+ cleanup:
+
+  if (acc != NULL)
+    free (acc);
+
+  free (range);
+
+  return retval;
+}
+
+/* Create a timer expiring after SECONDS and then every INTERVAL
+   seconds.  A value of zero for INTERVAL means that the timer only
+   expires once.  */
+static rs_workshop_timer_t *
+make_timer (rs_workshop_t *workshop, double seconds, double interval, void (*fun) (void *), void *arg)
+{
+  rs_workshop_timer_t *timer;
+  ULARGE_INTEGER due;
+  FILETIME ft;
+  DWORD period = 0;
+
+  /* Someone has to service the timers.  */
+  if (workshop->pool == NULL)
+    {
+      errno = ENOSYS;
+      return NULL;
+    }
+
+  timer = calloc (1, sizeof (rs_workshop_timer_t));
+  if (timer == NULL)
+    return NULL;
+
+  timer->workshop = workshop;
+  timer->periodic = (interval > 0.0);
+  timer->fun = fun;
+  timer->arg = arg;
+
+  timer->timer = CreateThreadpoolTimer (expire, timer, workshop->timer_env);
+  if (timer->timer == NULL)
+    {
+      free (timer);
+
+      errno = ENOMEM;
+      return NULL;
+    }
+
+  /* Add the timer to the list of pending timers.  */
+  EnterCriticalSection (workshop->timer_lock);
+
+  timer->prev = NULL;
+  timer->next = workshop->timers;
+  if (timer->next != NULL)
+    timer->next->prev = timer;
+
+  workshop->timers = timer;
+  timer->linked = 1;
+
+  LeaveCriticalSection (workshop->timer_lock);
+
+  /* A negative due time is relative to the current time and
+     measured in units of 100 nanoseconds.  */
+  if (! (seconds > 0.0))
+    seconds = 0.0;
+
+  due.QuadPart = (ULONGLONG) - (LONGLONG) (seconds * 1.0E7);
+  ft.dwLowDateTime = due.LowPart;
+  ft.dwHighDateTime = due.HighPart;
+
+  if (timer->periodic)
+    {
+      period = (DWORD) (interval * 1.0E3);
+      if (period == 0)
+	period = 1;
+    }
+
+  SetThreadpoolTimer (timer->timer, &ft, period, 0);
+
+  return timer;
+}
+
+/* Call-back function of a timer.  */
+static void
+expire (TP_CALLBACK_INSTANCE *instance, void *context, TP_TIMER *tp_timer)
+{
+  rs_workshop_timer_t *timer = context;
+
+  /* Not used.  */
+  (void) instance;
+
+  timer->fun (timer->arg);
+
+  /* A timer expiring only once closes itself unless
+     ‘rs_workshop_close’ took over.  */
+  if (! timer->periodic && unlink_timer (timer))
+    {
+      CloseThreadpoolTimer (tp_timer);
+
+      free (timer);
+    }
+}
+
+/* Remove the timer TIMER from the list of pending timers.  Return
+   value is non-zero if the calling thread removed the timer.  */
+static int
+unlink_timer (rs_workshop_timer_t *timer)
+{
+  rs_workshop_t *workshop = timer->workshop;
+  int linked;
+
+  EnterCriticalSection (workshop->timer_lock);
+
+  linked = timer->linked;
+  if (linked)
+    {
+      if (timer->prev != NULL)
+	timer->prev->next = timer->next;
+      else
+	workshop->timers = timer->next;
+
+      if (timer->next != NULL)
+	timer->next->prev = timer->prev;
+
+      timer->linked = 0;
+    }
+
+  LeaveCriticalSection (workshop->timer_lock);
+
+  return linked;
+}
+
+/* Stop the timer TIMER, wait for pending call-backs, and release
+   it.  */
+static void
+close_timer (rs_workshop_timer_t *timer)
+{
+  SetThreadpoolTimer (timer->timer, NULL, 0, 0);
+  WaitForThreadpoolTimerCallbacks (timer->timer, TRUE);
+  CloseThreadpoolTimer (timer->timer);
+
+  free (timer);
+}
+
+/* Process the work order of the future FUTURE.  */
+static void
+run_future (void *arg)
+{
+  rs_workshop_future_t *future = arg;
+
+  future->result = future->fun (future->arg);
+}
+
+/* Place a work order for the node NODE of a task graph.  */
+static void
+ready_node (rs_workshop_node_t *node)
+{
+  if (rs_workshop_group_order (node->graph->group, run_node, node) != 0)
+    run_node (node);
+}
+
+/* Process the node NODE of a task graph and place work orders for
+   all successors that become ready to run.  */
+static void
+run_node (void *arg)
+{
+  rs_workshop_node_t *node = arg;
+  rs_workshop_graph_t *graph = node->graph;
+  rs_workshop_node_t **succ;
+  size_t count, k;
+
+  node->fun (node->arg);
+
+  EnterCriticalSection (graph->lock);
+
+  node->done = 1;
+
+  succ = node->succ;
+  count = node->succ_count;
+
+  LeaveCriticalSection (graph->lock);
+
+  for (k = 0; k < count; ++k)
+    {
+      if (InterlockedDecrement (&succ[k]->deps) == 0)
+	ready_node (succ[k]);
+    }
+}
+
+/* Place a work order with priority PRIORITY as a member of GROUP.
+   Argument GROUP may be a null pointer.  */
+static int
+submit (rs_workshop_t *workshop, rs_workshop_group_t *group, int priority, void (*fun) (void *), void *arg)
+{
+  rs_task_t *task;
+
+  if (workshop->pool == NULL)
+    {
+      process (workshop, group, fun, arg);
+      return 0;
+    }
+
+  /* Put work order in an envelope.  */
+  task = alloc_task (workshop);
+  if (task == NULL)
+    return -1;
+
+  task->fun = fun;
+  task->arg = arg;
+  task->group = group;
+
+  if (group != NULL)
+    {
+      EnterCriticalSection (group->lock);
+      ++group->pending;
+      LeaveCriticalSection (group->lock);
+    }
+
+  InterlockedIncrement64 (&workshop->submitted);
+  count_queued (workshop);
+
+  if (TrySubmitThreadpoolCallback (worker, task, workshop->env + (priority - RS_WORKSHOP_PRIORITY_LOW)) == TRUE)
+    return 0;
+
+  InterlockedDecrement64 (&workshop->submitted);
+  InterlockedDecrement64 (&workshop->queued);
+
+  /* Cleanup.  */
+  if (group != NULL)
+    {
+      EnterCriticalSection (group->lock);
+
+      if (--group->pending == 0)
+	WakeAllConditionVariable (group->done);
+
+      LeaveCriticalSection (group->lock);
+    }
+
+  free_task (task, workshop);
+
+  errno = ENOMEM;
+  return -1;
+}
+
+/* Process a work order with ‘submit’ semantics in the calling
+   thread.  */
+static void
+process (rs_workshop_t *workshop, rs_workshop_group_t *group, void (*fun) (void *), void *arg)
+{
+  InterlockedIncrement64 (&workshop->submitted);
+
+  /* Skip cancelled work orders.  */
+  if (group == NULL || group->cancelled == 0)
+    fun (arg);
+
+  InterlockedIncrement64 (&workshop->completed);
+}
+
+/* Increment the number of queued work orders.  */
+static void
+count_queued (rs_workshop_t *workshop)
+{
+  LONG64 n, peak;
+
+  n = InterlockedIncrement64 (&workshop->queued);
+
+  peak = workshop->peak;
+  while (n > peak)
+    {
+      if (InterlockedCompareExchange64 (&workshop->peak, n, peak) == peak)
+	break;
+
+      peak = workshop->peak;
+    }
+}
+
+/* Get an envelope for a work order.  */
+static rs_task_t *
+alloc_task (rs_workshop_t *workshop)
+{
+  rs_task_t *task;
+
+  task = (rs_task_t *) InterlockedPopEntrySList (workshop->store);
+  if (task == NULL)
+    {
+      /* Entries of a singly linked list have to be aligned.  */
+      task = _aligned_malloc (sizeof (rs_task_t), MEMORY_ALLOCATION_ALIGNMENT);
+      if (task == NULL)
+	{
+	  errno = ENOMEM;
+	  return NULL;
+	}
+
+      InterlockedIncrement (&workshop->envelopes);
+    }
+
+  task->workshop = workshop;
+
+  return task;
+}
+
+/* Recycle an envelope.  */
+static void
+free_task (rs_task_t *task, rs_workshop_t *workshop)
+{
+  InterlockedPushEntrySList (workshop->store, &task->link);
 }
 
 /*
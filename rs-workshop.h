@@ -34,6 +34,9 @@
 #ifndef RS_WORKSHOP_H
 #define RS_WORKSHOP_H
 
+#include <stddef.h>
+#include <time.h>
+
 #ifdef __cplusplus
 #define RS_WORKSHOP_BEGIN_DECL extern "C" {
 #define RS_WORKSHOP_END_DECL }
@@ -70,6 +73,120 @@ typedef struct rs_workshop rs_workshop_t;
         to initialize the thread pool.  */
 extern rs_workshop_t *rs_workshop_open (int __workers);
 
+/* Options for opening a workshop.  */
+typedef struct rs_workshop_options rs_workshop_options_t;
+
+struct rs_workshop_options
+  {
+    /* Maximum number of co-workers.  See ‘rs_workshop_open’.  */
+    int workers;
+
+    /* Number of elements of a lock-free queue for work orders placed
+       by clients that are not a worker of the thread pool.  A value
+       of zero means to only use the mutex-protected queue.  Otherwise,
+       clients place work orders into the lock-free queue and only
+       fall back to the mutex-protected queue if the lock-free queue
+       is full.  Further work orders go to the mutex-protected queue,
+       too, until it is empty again.  Thus, work orders are processed
+       in order either way.  The number of elements is rounded up to
+       a power of two.  Ignored by the Windows implementation.  */
+    size_t ring_size;
+
+    /* Idle policy.  If there is nothing to do, a worker checks for
+       new work orders SPIN times with a pause instruction in between,
+       then YIELD times with yielding the processor in between, and
+       then goes to sleep until a new work order is placed.  Spinning
+       and yielding trade processor time for a lower latency when a
+       burst of work orders arrives.  A negative SPIN value means to
+       choose a default, which is zero unless the lock-free queue is
+       enabled.  The default for YIELD is zero.  Ignored by the Windows
+       implementation.  */
+    int spin;
+    int yield;
+
+    /* CPU placement.  If CPUS is not a null pointer, it is an array
+       of CPU_COUNT CPU numbers and the K-th worker is bound to the CPU
+       CPUS[K % CPU_COUNT].  Otherwise, if NUMA is non-zero, the workers
+       are distributed round-robin across the NUMA nodes of the system
+       and each worker is bound to the CPUs of its node.  If workers
+       are bound to CPUs, idle workers prefer to steal work orders from
+       co-workers on the same node.  Placement is a hint.  A worker
+       runs unbound if its CPUs are not available.  Only supported on
+       GNU/Linux, ignored on other systems.  */
+    int const *cpus;
+    size_t cpu_count;
+    int numa;
+
+    /* Maximum number of work orders in the queue for work orders
+       placed by clients that are not a worker of the thread pool.
+       A value of zero means that the queue is unbounded.  If BLOCK
+       is non-zero, a client placing a work order waits until there
+       is space in the queue.  Otherwise, the work order is rejected
+       if the queue is full.  A batch of work orders exceeding the
+       capacity is accepted if the queue is empty.  Work orders placed
+       by a worker are not limited.  Ignored by the Windows
+       implementation.  */
+    size_t capacity;
+    int block;
+
+    /* Non-zero means to measure the time from placing a work order
+       until a worker starts processing it and the time for processing
+       it, see ‘rs_workshop_stats’.  This requires two clock readings
+       per work order.  Ignored by the Windows implementation.  */
+    int timing;
+
+    /* Auto-scaling.  If IDLE_TIMEOUT is greater than zero, the
+       workshop starts with MIN_WORKERS workers and starts further
+       workers, up to WORKERS, while work orders pile up.  A worker
+       which is idle for IDLE_TIMEOUT seconds retires as long as there
+       are more than MIN_WORKERS workers.  A value of zero for
+       IDLE_TIMEOUT means that all workers are started when the
+       workshop is opened.  The default for MIN_WORKERS is one.  */
+    int min_workers;
+    double idle_timeout;
+
+    /* Maximum number of workers for ‘rs_workshop_resize’.  The places
+       of the workers are reserved when the workshop is opened.  A
+       value less than WORKERS, e.g. the default value of zero, means
+       WORKERS.  Ignored if WORKERS is zero.  */
+    int max_workers;
+
+    /* Per-worker data.  If WORKER_INIT is not a null pointer, a worker
+       thread calls it when it starts with the worker index as the
+       first argument and WORKER_ARG as the second argument.  The
+       return value is the worker data, see ‘rs_workshop_worker_data’.
+       If WORKER_EXIT is not a null pointer, a worker thread calls it
+       when it terminates with the worker index as the first argument,
+       the worker data as the second argument, and WORKER_ARG as the
+       third argument.  Since a worker thread calls these functions
+       itself, memory allocated by WORKER_INIT is local to the NUMA
+       node of the worker.  Ignored by the Windows implementation.  */
+    void *(*worker_init) (int, void *);
+    void (*worker_exit) (int, void *, void *);
+    void *worker_arg;
+  };
+
+/* Initialize workshop options with default values.
+
+   Argument OPTIONS is the address of an options object.
+
+   Call this function before setting individual options so that
+   new options added in the future have a defined value.  */
+extern void rs_workshop_options_init (rs_workshop_options_t *__options);
+
+/* Open a workshop with options.
+
+   Argument OPTIONS is the address of an options object.
+
+   Return value and error conditions are the same as for the
+   ‘rs_workshop_open’ function.  In addition, the following error
+   conditions are defined for this function:
+
+   EINVAL
+        Argument OPTIONS is a null pointer or an option has an
+        invalid value.  */
+extern rs_workshop_t *rs_workshop_open_ext (rs_workshop_options_t const *__options);
+
 /* Place a work order.
 
    First argument WORKSHOP is a pointer to a thread pool object.
@@ -77,6 +194,13 @@ extern rs_workshop_t *rs_workshop_open (int __workers);
     when the work order is processed by a worker.
    Third argument ARG is the argument for the call-back function.
 
+   A work order placed by a worker of WORKSHOP, i.e. from within a
+   call-back function, is queued up in the local work queue of that
+   worker.  The worker processes its local work orders in reverse
+   order whereas idle co-workers steal the oldest work orders from
+   the other workers.  Any other work order is queued up in a shared
+   queue and processed in order.
+
    Return value is zero on success.  In case of an error, -1 is
    returned and ‘errno’ is set to describe the error.
 
@@ -93,13 +217,114 @@ extern rs_workshop_t *rs_workshop_open (int __workers);
 
    EBUSY
         The work order is rejected because ‘rs_workshop_wait’ is
-        executing.  */
+        executing.  Work orders placed by a worker of WORKSHOP are
+        never rejected.
+
+   EAGAIN
+        The work order is rejected because the queue is full, see
+        the ‘capacity’ option of ‘rs_workshop_open_ext’.  */
 extern int rs_workshop_order (rs_workshop_t *__workshop, void (*__fun) (void *), void *__arg);
 
+/* Priorities of work orders.  */
+enum
+  {
+    /* Background work.  */
+    RS_WORKSHOP_PRIORITY_LOW = -1,
+
+    /* The default.  */
+    RS_WORKSHOP_PRIORITY_NORMAL = 0,
+
+    /* Latency critical work.  */
+    RS_WORKSHOP_PRIORITY_HIGH = 1
+  };
+
+/* Place a work order with a priority.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument PRIORITY is the priority of the work order, see
+    the ‘RS_WORKSHOP_PRIORITY_*’ constants.
+   Third argument FUN is the address of a function to be called
+    when the work order is processed by a worker.
+   Fourth argument ARG is the argument for the call-back function.
+
+   Workers process work orders with a higher priority first.  To
+   avoid starvation, workers consider work orders with a lower
+   priority first every so often.  Work orders with a high or low
+   priority are always queued up in a shared queue, even if they
+   are placed by a worker.
+
+   Return value and error conditions are the same as for the
+   ‘rs_workshop_order’ function.  In addition, the following error
+   conditions are defined for this function:
+
+   EINVAL
+        Argument PRIORITY is not a valid priority.  */
+extern int rs_workshop_order_priority (rs_workshop_t *__workshop, int __priority, void (*__fun) (void *), void *__arg);
+
+/* A work order.  */
+typedef struct rs_work_order rs_work_order_t;
+
+struct rs_work_order
+  {
+    /* The call-back function.  */
+    void (*fun) (void *);
+
+    /* Function argument.  */
+    void *arg;
+  };
+
+/* Place multiple work orders at once.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument ORDERS is an array of work orders.
+   Third argument COUNT is the number of work orders.
+
+   This is equivalent to calling ‘rs_workshop_order’ for each
+   element of ORDERS, but the work orders are queued up in a single
+   step and at most COUNT idle workers are activated.  Either all
+   work orders are placed or none of them.  The system thread pool
+   used by the Windows implementation can not revoke work orders.
+   Thus, if it rejects a work order after the first one, the Windows
+   implementation processes the remaining work orders in the calling
+   thread and the call succeeds.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        One of the following is true.
+
+           * Argument WORKSHOP is a null pointer.
+           * Argument ORDERS is a null pointer and COUNT is not zero.
+           * The call-back function of a work order is a null pointer.
+
+   ENOMEM
+        The system ran out of memory.
+
+   EBUSY
+        The work orders are rejected because ‘rs_workshop_wait’ is
+        executing.  Work orders placed by a worker of WORKSHOP are
+        never rejected.
+
+   EAGAIN
+        The work orders are rejected because the queue is full, see
+        the ‘capacity’ option of ‘rs_workshop_open_ext’.  */
+extern int rs_workshop_order_batch (rs_workshop_t *__workshop, rs_work_order_t const *__orders, size_t __count);
+
 /* Wait until all work orders are processed.
 
    Argument WORKSHOP is a pointer to a thread pool object.
 
+   If the calling thread is a worker of WORKSHOP, i.e. the function
+   is called from within a call-back function, the calling worker
+   processes pending work orders until all other workers are idle.
+   Otherwise, the calling thread blocks until all workers are idle.
+   The Windows implementation waits for the work order of the calling
+   worker, too.  Thus, it must not be called from within a call-back
+   function.
+
    Return value is zero on success.  In case of an error, -1 is
    returned and ‘errno’ is set to describe the error.
 
@@ -109,6 +334,668 @@ extern int rs_workshop_order (rs_workshop_t *__workshop, void (*__fun) (void *),
         Argument WORKSHOP is a null pointer.  */
 extern int rs_workshop_wait (rs_workshop_t *__workshop);
 
+/* Opaque task group object.  */
+typedef struct rs_workshop_group rs_workshop_group_t;
+
+/* Create a task group.
+
+   Argument WORKSHOP is a pointer to a thread pool object.
+
+   A task group tracks the work orders placed by one client so that
+   the client can wait for its own work orders while other clients
+   continue to place work orders.
+
+   Return value is a pointer to a task group object.  In case of an
+   error, a null pointer is returned and ‘errno’ is set to describe
+   the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument WORKSHOP is a null pointer.
+
+   ENOMEM
+        The system ran out of memory.  */
+extern rs_workshop_group_t *rs_workshop_group_new (rs_workshop_t *__workshop);
+
+/* Destroy a task group.
+
+   Argument GROUP is a pointer to a task group object.  It is no
+    error if argument GROUP is a null pointer.
+
+   Waits until all work orders of the task group are processed before
+   the task group object is destroyed.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   No error conditions are defined for this function.  */
+extern int rs_workshop_group_delete (rs_workshop_group_t *__group);
+
+/* Set the priority of the work orders of a task group.
+
+   First argument GROUP is a pointer to a task group object.
+   Second argument PRIORITY is the priority of the work orders, see
+    ‘rs_workshop_order_priority’.
+
+   The priority applies to work orders placed afterwards.  The
+   default priority is ‘RS_WORKSHOP_PRIORITY_NORMAL’.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument GROUP is a null pointer or argument PRIORITY is
+        not a valid priority.  */
+extern int rs_workshop_group_set_priority (rs_workshop_group_t *__group, int __priority);
+
+/* Place a work order as a member of a task group.
+
+   First argument GROUP is a pointer to a task group object.
+   Second argument FUN is the address of a function to be called
+    when the work order is processed by a worker.
+   Third argument ARG is the argument for the call-back function.
+
+   Return value and error conditions are the same as for the
+   ‘rs_workshop_order’ function.  */
+extern int rs_workshop_group_order (rs_workshop_group_t *__group, void (*__fun) (void *), void *__arg);
+
+/* Place multiple work orders as members of a task group.
+
+   First argument GROUP is a pointer to a task group object.
+   Second argument ORDERS is an array of work orders.
+   Third argument COUNT is the number of work orders.
+
+   Return value and error conditions are the same as for the
+   ‘rs_workshop_order_batch’ function.  */
+extern int rs_workshop_group_order_batch (rs_workshop_group_t *__group, rs_work_order_t const *__orders, size_t __count);
+
+/* Wait until all work orders of a task group are processed.
+
+   Argument GROUP is a pointer to a task group object.
+
+   Other work orders, including work orders of other task groups,
+   are not affected.  In particular, work orders are not rejected
+   while this function is executing.
+
+   If the calling thread is a worker of the thread pool, the calling
+   worker processes pending work orders, not necessarily members of
+   the task group, until the task group is done.  Thus, a work order
+   can place and wait for nested work orders without a deadlock even
+   if the number of workers is fixed.
+
+   The Windows implementation does not help.  The system thread pool
+   does not reveal its queued work orders.  Thus, a waiting worker
+   blocks its thread.  Nested work orders can only run on other
+   threads.  If all threads of the pool, i.e. WORKERS threads, wait
+   for nested work orders, the program deadlocks.  This applies to
+   ‘rs_workshop_future_wait’, ‘rs_workshop_graph_wait’,
+   ‘rs_workshop_for’, and ‘rs_workshop_reduce’, too.  On Windows,
+   either limit the nesting depth below the number of workers or do
+   not wait from within a call-back function.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument GROUP is a null pointer.  */
+extern int rs_workshop_group_wait (rs_workshop_group_t *__group);
+
+/* Cancel the work orders of a task group.
+
+   Argument GROUP is a pointer to a task group object.
+
+   Queued work orders of the task group are skipped, i.e. they are
+   removed from the queue without calling the call-back function.
+   Work orders placed afterwards are skipped, too.  Running work
+   orders are not interrupted but they can poll the cancellation
+   state, see ‘rs_workshop_cancelled’.  A skipped work order is
+   done as far as ‘rs_workshop_group_wait’ is concerned.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument GROUP is a null pointer.  */
+extern int rs_workshop_group_cancel (rs_workshop_group_t *__group);
+
+/* Return non-zero if a task group is cancelled.
+
+   Argument GROUP is a pointer to a task group object.
+
+   Return value is zero if argument GROUP is a null pointer.  */
+extern int rs_workshop_group_cancelled (rs_workshop_group_t *__group);
+
+/* Return non-zero if the current work order is cancelled.
+
+   Argument WORKSHOP is a pointer to a thread pool object.
+
+   A work order is cancelled if it is a member of a task group and
+   the task group is cancelled, see ‘rs_workshop_group_cancel’.
+   Call this function from within a call-back function to stop a
+   long running work order early.
+
+   Return value is zero if the calling thread is not processing a
+   work order of WORKSHOP.  */
+extern int rs_workshop_cancelled (rs_workshop_t *__workshop);
+
+/* Place a work order at a certain time.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument ABSTIME is the time when to place the work order.
+    The time is measured against the ‘CLOCK_REALTIME’ clock like for
+    ‘pthread_cond_timedwait’.
+   Third argument FUN is the address of a function to be called
+    when the work order is processed by a worker.
+   Fourth argument ARG is the argument for the call-back function.
+
+   The function returns immediately.  The workers of the thread pool
+   keep track of pending timers, there is no extra thread.  An idle
+   worker sleeps until the next timer expires and busy workers check
+   for expired timers after each work order.  If ABSTIME is in the
+   past, the work order is placed as soon as possible.  Pending timers
+   are not waited for by ‘rs_workshop_wait’ and they are discarded by
+   ‘rs_workshop_close’.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument WORKSHOP, ABSTIME, or FUN is a null pointer or
+        argument ABSTIME is not a valid time.
+
+   ENOMEM
+        The system ran out of memory.
+
+   ENOSYS
+        The thread pool has no workers.  */
+extern int rs_workshop_order_at (rs_workshop_t *__workshop, struct timespec const *__abstime, void (*__fun) (void *), void *__arg);
+
+/* Place a work order after a delay.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument SECONDS is the delay in seconds.
+   Third argument FUN is the address of a function to be called
+    when the work order is processed by a worker.
+   Fourth argument ARG is the argument for the call-back function.
+
+   The delay is measured against a monotonic clock.  Otherwise, this
+   function is like ‘rs_workshop_order_at’.  Return value and error
+   conditions are the same, too.  */
+extern int rs_workshop_order_after (rs_workshop_t *__workshop, double __seconds, void (*__fun) (void *), void *__arg);
+
+/* Opaque timer object.  */
+typedef struct rs_workshop_timer rs_workshop_timer_t;
+
+/* Place a work order periodically.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument INTERVAL is the period in seconds.
+   Third argument FUN is the address of a function to be called
+    when the work order is processed by a worker.
+   Fourth argument ARG is the argument for the call-back function.
+
+   The first work order is placed after one period.  Missed periods
+   are skipped, e.g. if all workers are busy for a long time.  Call
+   ‘rs_workshop_timer_cancel’ to stop placing work orders.
+
+   Return value is a pointer to a timer object.  In case of an error,
+   a null pointer is returned and ‘errno’ is set to describe the error.
+   The error conditions are the same as for ‘rs_workshop_order_at’.
+   In addition, ‘EINVAL’ means that argument INTERVAL is not greater
+   than zero.  */
+extern rs_workshop_timer_t *rs_workshop_order_every (rs_workshop_t *__workshop, double __interval, void (*__fun) (void *), void *__arg);
+
+/* Cancel a periodic work order.
+
+   Argument TIMER is a pointer to a timer object.  It is no error
+    if argument TIMER is a null pointer.
+
+   No more work orders are placed after this function returns.  If
+   the timer expires concurrently, this function waits until the work
+   order is placed.  Work orders placed before are not affected.  The timer object must not
+   be used afterwards.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   No error conditions are defined for this function.  */
+extern int rs_workshop_timer_cancel (rs_workshop_timer_t *__timer);
+
+/* Opaque future object.  */
+typedef struct rs_workshop_future rs_workshop_future_t;
+
+/* Place a work order with a future.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument FUN is the address of a function to be called
+    when the work order is processed by a worker.
+   Third argument ARG is the argument for the call-back function.
+
+   A future is a handle for waiting for a single work order and for
+   retrieving the return value of the call-back function.  Release
+   the future by calling ‘rs_workshop_future_release’.  Futures are
+   recycled by the thread pool.
+
+   Return value is a pointer to a future object.  In case of an
+   error, a null pointer is returned and ‘errno’ is set to describe
+   the error.  The error conditions are the same as for the
+   ‘rs_workshop_order’ function.  */
+extern rs_workshop_future_t *rs_workshop_order_future (rs_workshop_t *__workshop, void *(*__fun) (void *), void *__arg);
+
+/* Wait until the work order of a future is processed.
+
+   Argument FUTURE is a pointer to a future object.
+
+   The calling thread helps like with ‘rs_workshop_group_wait’.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument FUTURE is a null pointer.  */
+extern int rs_workshop_future_wait (rs_workshop_future_t *__future);
+
+/* Check if the work order of a future is processed.
+
+   Argument FUTURE is a pointer to a future object.
+
+   Return value is zero if the work order is processed.  Otherwise,
+   -1 is returned and ‘errno’ is set to describe the reason.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument FUTURE is a null pointer.
+
+   EAGAIN
+        The work order is not yet processed.  */
+extern int rs_workshop_future_try_wait (rs_workshop_future_t *__future);
+
+/* Return the result of a future.
+
+   Argument FUTURE is a pointer to a future object.
+
+   Waits until the work order is processed like
+   ‘rs_workshop_future_wait’.
+
+   Return value is the return value of the call-back function.
+   If argument FUTURE is a null pointer, a null pointer is returned
+   and ‘errno’ is set to ‘EINVAL’.  */
+extern void *rs_workshop_future_result (rs_workshop_future_t *__future);
+
+/* Cancel the work order of a future.
+
+   Argument FUTURE is a pointer to a future object.
+
+   If the work order is still queued, it is skipped and the result
+   of the future is a null pointer.  Otherwise, the call-back function
+   can poll the cancellation state, see ‘rs_workshop_cancelled’.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument FUTURE is a null pointer.  */
+extern int rs_workshop_future_cancel (rs_workshop_future_t *__future);
+
+/* Release a future.
+
+   Argument FUTURE is a pointer to a future object.  It is no
+    error if argument FUTURE is a null pointer.
+
+   Waits until the work order is processed before the future object
+   is recycled.  The future object must not be used afterwards.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   No error conditions are defined for this function.  */
+extern int rs_workshop_future_release (rs_workshop_future_t *__future);
+
+/* Opaque task graph object.  */
+typedef struct rs_workshop_graph rs_workshop_graph_t;
+
+/* Opaque task graph node.  */
+typedef struct rs_workshop_node rs_workshop_node_t;
+
+/* Create a task graph.
+
+   Argument WORKSHOP is a pointer to a thread pool object.
+
+   A task graph is a set of work orders with dependencies, i.e. a
+   directed acyclic graph.  A work order is placed automatically when
+   all of its predecessors are processed.  Thus, independent branches
+   of the graph run in parallel without waiting for the whole thread
+   pool between stages.
+
+   Return value is a pointer to a task graph object.  In case of an
+   error, a null pointer is returned and ‘errno’ is set to describe
+   the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument WORKSHOP is a null pointer.
+
+   ENOMEM
+        The system ran out of memory.  */
+extern rs_workshop_graph_t *rs_workshop_graph_new (rs_workshop_t *__workshop);
+
+/* Destroy a task graph.
+
+   Argument GRAPH is a pointer to a task graph object.  It is no
+    error if argument GRAPH is a null pointer.
+
+   Waits until all nodes of the task graph are processed before the
+   task graph object and all of its nodes are destroyed.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   No error conditions are defined for this function.  */
+extern int rs_workshop_graph_delete (rs_workshop_graph_t *__graph);
+
+/* Add a node to a task graph.
+
+   First argument GRAPH is a pointer to a task graph object.
+   Second argument FUN is the address of a function to be called
+    when the node is processed by a worker.
+   Third argument ARG is the argument for the call-back function.
+   Fourth argument PREDS is an array of nodes of the task graph.
+   Fifth argument COUNT is the number of nodes in PREDS.
+
+   The node is processed after all nodes in PREDS are processed.
+   If there are no unfinished predecessors, a work order for the
+   node is placed immediately.  Nodes can be added at any time,
+   including from within the call-back function of another node.
+   The nodes are owned by the task graph.
+
+   If the work order for a node is rejected when it becomes ready
+   to run, e.g. because ‘rs_workshop_wait’ is executing, the node is
+   processed by the thread which finishes the last predecessor or by
+   the thread adding the node.
+
+   Return value is a pointer to the new node.  In case of an error,
+   a null pointer is returned and ‘errno’ is set to describe the
+   error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        One of the following is true.
+
+           * Argument GRAPH is a null pointer.
+           * Argument FUN is a null pointer.
+           * Argument PREDS is a null pointer and COUNT is not zero.
+           * An element of PREDS is a null pointer or a node of
+             another task graph.
+
+   ENOMEM
+        The system ran out of memory.  */
+extern rs_workshop_node_t *rs_workshop_graph_node (rs_workshop_graph_t *__graph, void (*__fun) (void *), void *__arg, rs_workshop_node_t *const *__preds, size_t __count);
+
+/* Wait until all nodes of a task graph are processed.
+
+   Argument GRAPH is a pointer to a task graph object.
+
+   The calling thread helps like with ‘rs_workshop_group_wait’.
+   New nodes can be added to the task graph afterwards.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument GRAPH is a null pointer.  */
+extern int rs_workshop_graph_wait (rs_workshop_graph_t *__graph);
+
+/* Process a range of indices in parallel.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument BEGIN is the first index.
+   Third argument END is one past the last index.
+   Fourth argument GRAIN is the number of indices processed in one
+    step.  A value of zero means to choose a grain size automatically.
+   Fifth argument FUN is the address of a function to be called for
+    a sub-range of indices.  The first two arguments of FUN are the
+    first and one past the last index of the sub-range.
+   Sixth argument ARG is the last argument for the call-back function.
+
+   The range is split recursively into halves as long as there are
+   idle workers.  The calling thread processes a sub-range, too, and
+   returns when all indices are processed.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        One of the following is true.
+
+           * Argument WORKSHOP is a null pointer.
+           * Argument FUN is a null pointer.
+           * Argument BEGIN is greater than END.  */
+extern int rs_workshop_for (rs_workshop_t *__workshop, size_t __begin, size_t __end, size_t __grain, void (*__fun) (size_t, size_t, void *), void *__arg);
+
+/* Reduce a range of indices in parallel.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument BEGIN is the first index.
+   Third argument END is one past the last index.
+   Fourth argument GRAIN is the number of indices processed in one
+    step.  A value of zero means to choose a grain size automatically.
+   Fifth argument FUN is the address of a function to be called for
+    a sub-range of indices.  The first two arguments of FUN are the
+    first and one past the last index of the sub-range.  The third
+    argument of FUN is the address of an accumulator.  FUN shall add
+    the result for the sub-range to the accumulator.
+   Sixth argument COMBINE is the address of a function to combine
+    two partial results.  The first argument of COMBINE is the address
+    of the accumulator and the second argument is the address of the
+    partial result.
+   Seventh argument RESULT is the address of the result.  On entry,
+    RESULT has to contain the identity element of the reduction.
+   Eighth argument SIZE is the size of the result in bytes.
+   Ninth argument ARG is the last argument for the call-back functions.
+
+   Every worker and the calling thread have their own accumulator,
+   initialized with a copy of the identity element.  Thus, FUN does
+   not have to synchronize access to the accumulator.  When all
+   indices are processed, the partial results are combined into
+   RESULT by the calling thread.  Since the order of the sub-ranges
+   is not defined, COMBINE should be associative and commutative.
+   If FUN waits for other work orders, the worker may process another
+   sub-range of the same reduction in the meantime.  Thus, FUN should
+   update the accumulator before waiting.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        One of the following is true.
+
+           * Argument WORKSHOP is a null pointer.
+           * Argument FUN or COMBINE is a null pointer.
+           * Argument RESULT is a null pointer.
+           * Argument SIZE is zero.
+           * Argument BEGIN is greater than END.
+
+   ENOMEM
+        The system ran out of memory.  */
+extern int rs_workshop_reduce (rs_workshop_t *__workshop, size_t __begin, size_t __end, size_t __grain, void (*__fun) (size_t, size_t, void *, void *), void (*__combine) (void *, void const *, void *), void *__result, size_t __size, void *__arg);
+
+/* Return the index of the calling worker.
+
+   Argument WORKSHOP is a pointer to a thread pool object.
+
+   The index of a worker is in the range from zero up to but
+   excluding the maximum number of workers, see the ‘max_workers’
+   option of ‘rs_workshop_open_ext’.
+   The index is stable for the lifetime of the worker thread.  Thus,
+   a work order can use it to access per-worker scratch memory
+   without locking.
+
+   Return value is the index of the calling worker, or -1 if the
+   calling thread is not a worker of WORKSHOP, e.g. if a client
+   processes a work order because there are no workers.  The Windows
+   implementation always returns -1.  */
+extern int rs_workshop_worker_id (rs_workshop_t *__workshop);
+
+/* Return the data of the calling worker.
+
+   Argument WORKSHOP is a pointer to a thread pool object.
+
+   Return value is the return value of the ‘worker_init’ option of
+   ‘rs_workshop_open_ext’ for the calling worker, or a null pointer
+   if the calling thread is not a worker of WORKSHOP.  */
+extern void *rs_workshop_worker_data (rs_workshop_t *__workshop);
+
+/* Number of buckets of a latency histogram.  Bucket K counts the
+   durations from 2^K up to but excluding 2^(K+1) nanoseconds.  The
+   first bucket includes durations less than one nanosecond and the
+   last bucket includes all longer durations.  */
+#define RS_WORKSHOP_HISTOGRAM_SIZE 32
+
+/* Statistics of a worker.  */
+typedef struct rs_workshop_worker_stats rs_workshop_worker_stats_t;
+
+struct rs_workshop_worker_stats
+  {
+    /* Number of placed work orders.  */
+    size_t submitted;
+
+    /* Number of processed work orders.  */
+    size_t completed;
+
+    /* Time in seconds spent processing work orders and waiting for
+       work orders.  Only measured if the ‘timing’ option is set.  */
+    double busy_time;
+    double idle_time;
+
+    /* Histogram of the time from placing a work order until a worker
+       starts processing it.  Only measured if the ‘timing’ option is
+       set.  */
+    size_t wait_histogram[RS_WORKSHOP_HISTOGRAM_SIZE];
+
+    /* Histogram of the time for processing a work order.  The time
+       includes the time of other work orders processed while waiting.
+       Only measured if the ‘timing’ option is set.  */
+    size_t run_histogram[RS_WORKSHOP_HISTOGRAM_SIZE];
+  };
+
+/* Statistics of a thread pool.  */
+typedef struct rs_workshop_stats rs_workshop_stats_t;
+
+struct rs_workshop_stats
+  {
+    /* Number of allocated envelopes for work orders.  Envelopes
+       are recycled, thus this number only grows if there are more
+       pending work orders than ever before.  */
+    size_t envelopes;
+
+    /* Number of times the envelope pool had to grow.  */
+    size_t slabs;
+
+    /* Number of running workers.  */
+    int workers;
+
+    /* Current and maximum number of queued work orders.  */
+    size_t queued;
+    size_t peak_queued;
+
+    /* Sum of the statistics of all workers.  The number of placed
+       work orders includes the work orders of clients that are not
+       a worker of the thread pool.  */
+    rs_workshop_worker_stats_t total;
+  };
+
+/* Query statistics.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument STATS is the address of a statistics object.
+
+   The Windows implementation only reports the number of envelopes
+   and the number of placed, queued, and processed work orders.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument WORKSHOP or STATS is a null pointer.  */
+extern int rs_workshop_stats (rs_workshop_t *__workshop, rs_workshop_stats_t *__stats);
+
+/* Query statistics of a worker.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument INDEX is the index of a worker (zero based).
+   Third argument STATS is the address of a statistics object.
+
+   The statistics are collected without locking.  Thus, the values
+   may be slightly out of date while workers are busy.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        Argument WORKSHOP or STATS is a null pointer or argument
+        INDEX is not the index of a worker.
+
+   ENOSYS
+        The function is not supported by the Windows implementation.  */
+extern int rs_workshop_worker_stats (rs_workshop_t *__workshop, int __index, rs_workshop_worker_stats_t *__stats);
+
+/* Change the number of workers.
+
+   First argument WORKSHOP is a pointer to a thread pool object.
+   Second argument WORKERS is the new number of workers.
+
+   If there are more workers than WORKERS, surplus workers retire as
+   soon as they are idle.  Otherwise, missing workers are started
+   right away.  If auto-scaling is enabled, WORKERS is the maximum
+   number of workers and further workers are only started on demand,
+   see the ‘idle_timeout’ option of ‘rs_workshop_open_ext’.
+
+   Return value is zero on success.  In case of an error, -1 is
+   returned and ‘errno’ is set to describe the error.
+
+   The following error conditions are defined for this function:
+
+   EINVAL
+        One of the following is true.
+
+           * Argument WORKSHOP is a null pointer.
+           * Argument WORKERS is less than one.
+           * Argument WORKERS is greater than the maximum number of
+             workers, see the ‘max_workers’ option of
+             ‘rs_workshop_open_ext’.
+           * The workshop has no workers.
+
+   EAGAIN
+        The system lacked the necessary resources to start another
+        worker.  The workers started so far keep running.  */
+extern int rs_workshop_resize (rs_workshop_t *__workshop, int __workers);
+
 /* Close a workshop.
 
    Argument WORKSHOP is a pointer to a thread pool object.  It is